@@ -10,6 +10,45 @@
  * - On any keypress: only turns on if currently off (avoids redundant WMI calls)
  * - Auto-off timer is restarted via mod_delayed_work() (less churn / fewer races)
  * - Uses dedicated WQ_UNBOUND workqueue to avoid hogging per-CPU worker threads
+ * - Ignored keys (media keys, lone modifiers, a user list) and autorepeat are
+ *   dropped with a single bit test before anything else runs
+ * - Keypress rate is tracked with an EWMA: during bursts the off timer is not
+ *   re-armed per key and debounce is relaxed
+ * - Turning the light on runs on its own WQ_HIGHPRI workqueue
+ *
+ * Calibration:
+ * - At load, if the applied state is known, a few identical writes are timed to
+ *   measure firmware latency; the adaptive debounce never goes below it
+ * - Measured/derived values: /sys/class/leds/acer::kbd_backlight/fw_latency_*_us
+ *
+ * Power profile:
+ * - Writing the platform profile name to the LED "platform_profile" attribute
+ *   switches to power-saving lighting on low-power/quiet/cool (brightness cap,
+ *   shorter auto-off, static effect) with at most one firmware write
+ *
+ * Firmware-native timeout (optional):
+ * - fw_timeout_idx selects the payload byte carrying the EC's own idle timeout;
+ *   when set and the load-time write succeeds, the auto-off timers and pre-wake
+ *   hooks are not used (software path is the fallback); the keyboard notifier
+ *   only feeds keyboard activity while it has subscribers, and "lit" reads -1
+ *
+ * Pre-wake (optional):
+ * - Lights the keyboard before the first keypress on lid open, PM resume, or a
+ *   write to the LED "prewake" attribute (e.g. from a session unlock hook)
+ * - Then starts the normal auto-off countdown
+ *
+ * LED core integration:
+ * - Non-blocking brightness_set (async_set=1) records the target atomically and
+ *   queues one module work item; the LED core's own set_brightness_work hop is
+ *   skipped, and back-to-back sets coalesce to the latest value
+ *
+ * Keyboard activity (shared):
+ * - "kbd-activity" LED trigger and an exported notifier chain (acer_brightness.h)
+ * - Delivered once per idle->active transition, not per key
+ *
+ * Testing:
+ * - mock_backend=1 replaces the WMI call with a sleep of mock_latency_us, so the
+ *   module can be loaded (and benchmarked, see tools/) on any machine
  *
  * Notes:
  * - Controls keyboard backlight brightness embedded in gaming payload byte 2 (0-100)
@@ -32,6 +71,25 @@
 #include <linux/keyboard.h>
 #include <linux/notifier.h>
 #include <linux/atomic.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+#include <linux/string.h>
+#include <linux/uaccess.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/delay.h>
+#include <linux/input.h>
+#include <linux/suspend.h>
+#include <linux/slab.h>
+#include <linux/device.h>
+#include <linux/bitmap.h>
+#include <linux/moduleparam.h>
+#include <linux/percpu.h>
+#include <linux/pid_namespace.h>
+#include <linux/rcupdate.h>
+
+#include "acer_brightness.h"
 
 MODULE_AUTHOR("Modified by Lautaro Lucas C. (lau-bin)");
 MODULE_DESCRIPTION("Acer keyboard backlight brightness-only with keypress auto-off (optimized workqueue usage)");
@@ -68,30 +126,591 @@ MODULE_PARM_DESC(initial_brightness, "Initial cached brightness (0-100) exposed
 
 /*
  * Optional debounce for "turn on" when off (ms).
- * 0 disables. Useful if your firmware is extremely slow and keypress storms happen.
+ * -1 derives it from the typing rate, 0 disables, >0 is a fixed window.
+ * Useful if your firmware is extremely slow and keypress storms happen.
  */
-static int on_debounce_ms = 0;
+static int on_debounce_ms = -1;
 module_param(on_debounce_ms, int, 0644);
-MODULE_PARM_DESC(on_debounce_ms, "Minimum ms between off->on applies (0 disables)");
+MODULE_PARM_DESC(on_debounce_ms, "Minimum ms between off->on applies (-1 adaptive, 0 disables)");
 
 static DEFINE_MUTEX(kbb_mutex);
 static u8 cached_brightness;
+static bool kbb_exiting; /* set under kbb_mutex on unload: nothing turns the light on */
 
 /* Track last applied state to avoid redundant firmware writes */
 static atomic_t is_lit = ATOMIC_INIT(0);          /* 0=off, 1=on */
 static atomic_t applied_brightness = ATOMIC_INIT(-1); /* -1=unknown, else 0..100 */
 
+/*
+ * Idle time after which keyboard activity is reported as ended, in ms.
+ * Drives the "kbd-activity" LED trigger and the exported notifier chain.
+ */
+static int kbd_activity_timeout_ms = 5000;
+module_param(kbd_activity_timeout_ms, int, 0644);
+MODULE_PARM_DESC(kbd_activity_timeout_ms, "Milliseconds without keypress before kbd-activity goes idle");
+
+/*
+ * Mock backend for benchmarking without the hardware: no WMI calls are made,
+ * each firmware write just sleeps for mock_latency_us.
+ */
+static bool mock_backend = false;
+module_param(mock_backend, bool, 0444);
+MODULE_PARM_DESC(mock_backend, "Simulate the gaming WMI interface instead of calling firmware (load-time only)");
+
+static int mock_latency_us = 0;
+module_param(mock_latency_us, int, 0644);
+MODULE_PARM_DESC(mock_latency_us, "Simulated firmware write latency in microseconds (mock_backend only)");
+
+/*
+ * Firmware-native keyboard idle timeout. The byte position is model specific
+ * and there is no readback to probe it, so it is opt-in: -1 keeps the
+ * software auto-off path. fw_timeout_s=0 derives seconds from auto_off_ms.
+ */
+static int fw_timeout_idx = -1;
+module_param(fw_timeout_idx, int, 0444);
+MODULE_PARM_DESC(fw_timeout_idx, "Payload byte (0-15, not 2/9) for the firmware idle timeout; -1 uses software auto-off");
+
+static int fw_timeout_s = 0;
+module_param(fw_timeout_s, int, 0444);
+MODULE_PARM_DESC(fw_timeout_s, "Firmware idle timeout in seconds (1-255, 0 derives from auto_off_ms)");
+
+static bool fw_timeout_active;
+static bool fw_timeout_derived; /* fw_timeout_s was 0: recomputed on every write */
+
+/* Time a few idempotent writes at load to learn the firmware latency */
+static bool calibrate = true;
+module_param(calibrate, bool, 0444);
+MODULE_PARM_DESC(calibrate, "Measure firmware write latency at load by rewriting the state the module assumes");
+
+#define ACER_KBB_CALIB_WRITES 5
+
+static u32 calib_min_us, calib_avg_us, calib_max_us;
+static u32 calib_debounce_ms; /* floor for the adaptive debounce, 0 = not calibrated */
+
+/* Lighting applied while the platform profile is a power-saving one */
+static int powersave_max_brightness = 30;
+module_param(powersave_max_brightness, int, 0644);
+MODULE_PARM_DESC(powersave_max_brightness, "Brightness cap (0-100) in low-power/quiet/cool platform profiles");
+
+static int powersave_auto_off_ms = 1000;
+module_param(powersave_auto_off_ms, int, 0644);
+MODULE_PARM_DESC(powersave_auto_off_ms, "auto_off_ms upper bound in low-power/quiet/cool platform profiles (0 keeps auto_off_ms)");
+
+static bool powersave;
+
+/* Pre-wake triggers (bitmask) */
+#define ACER_KBB_PREWAKE_LID    BIT(0)
+#define ACER_KBB_PREWAKE_RESUME BIT(1)
+#define ACER_KBB_PREWAKE_UNLOCK BIT(2)
+
+static int prewake = ACER_KBB_PREWAKE_LID | ACER_KBB_PREWAKE_RESUME | ACER_KBB_PREWAKE_UNLOCK;
+module_param(prewake, int, 0644);
+MODULE_PARM_DESC(prewake, "Light keyboard ahead of first keypress on: 1=lid open, 2=resume, 4=prewake attribute write (bitmask, 0 disables)");
+
+/*
+ * LED core callers that cannot sleep (triggers, led_set_brightness_nosleep,
+ * and the brightness attribute itself) get a setter that only records the
+ * target and queues set_work, instead of the core's own set_brightness_work
+ * followed by a blocking call into this module.
+ */
+static bool async_set = true;
+module_param(async_set, bool, 0444);
+MODULE_PARM_DESC(async_set, "Non-blocking LED brightness_set handed straight to the module workqueue (load-time only)");
+
 /* Debounce bookkeeping */
 static unsigned long last_on_apply_jiffies;
 
+/*
+ * Typing-rate estimator: EWMA (weight 1/8) of the gap between keypresses, in
+ * microseconds. Gaps are capped so a long idle pulls the estimate down fast.
+ */
+#define ACER_KBB_GAP_CAP_US        (10 * USEC_PER_SEC)
+#define ACER_KBB_BURST_KEYS_PER_S  5    /* at or above: burst */
+#define ACER_KBB_DEBOUNCE_MAX_MS   500  /* cap of the adaptive debounce window */
+
+static u32 kbd_gap_ewma_us = ACER_KBB_GAP_CAP_US;
+
 static struct delayed_work turn_on_work;
 static struct delayed_work turn_off_work;
 
+/*
+ * Latest request from the non-blocking setter, -1 if none: requester pid in
+ * the upper 32 bits, brightness in the lower. One word, so racing writers
+ * can't pair one's value with the other's pid in the audit log.
+ */
+static atomic64_t set_req = ATOMIC64_INIT(-1);
+static struct work_struct set_work;
+
 static struct notifier_block kbd_nb;
+static struct notifier_block pm_nb;
+static bool lid_handler_registered;
+
+/*
+ * Why the pending turn_on_work was queued, for the audit log: requester pid
+ * in the upper 32 bits (0 if not a task), enum acer_kbb_src in the lower.
+ */
+static atomic64_t turn_on_reason;
+
+/* Keyboard activity state shared by the LED trigger and notifier chain */
+static atomic_t kbd_active = ATOMIC_INIT(0);      /* 0=idle, 1=active */
+static unsigned long kbd_last_key_jiffies;
+/* Orders each kbd_active edge with its delivery, so subscribers see them alternate */
+static DEFINE_SPINLOCK(kbd_activity_lock);
+static struct delayed_work kbd_idle_work;
+
+DEFINE_LED_TRIGGER(kbd_activity_trig);
+static ATOMIC_NOTIFIER_HEAD(kbd_activity_chain);
 
 /* Dedicated workqueue (unbound) to avoid per-CPU worker contention */
 static struct workqueue_struct *acer_wq;
 
+/*
+ * All turn_on_work runs here, so it is not queued behind normal work. It must
+ * only ever be queued on this one workqueue: a work item queued on two can run
+ * concurrently with itself, and the turn-on path checks state outside kbb_mutex.
+ */
+static struct workqueue_struct *acer_hi_wq;
+
+static struct dentry *acer_dbg_dir;
+
+/* ---- Change audit log ---- */
+
+/*
+ * Fixed-size ring of brightness change records, filled from the sysfs setter
+ * and the work functions. No allocation on the record path; readable through
+ * debugfs as text ("audit") and as raw records ("audit_bin").
+ */
+#define ACER_KBB_AUDIT_LEN 128
+
+enum acer_kbb_src {
+	ACER_KBB_SRC_LOAD,
+	ACER_KBB_SRC_SYSFS,
+	ACER_KBB_SRC_KEY_ON,
+	ACER_KBB_SRC_AUTO_OFF,
+	ACER_KBB_SRC_PREWAKE,
+	ACER_KBB_SRC_PROFILE,
+};
+
+static const char * const acer_kbb_src_names[] = {
+	[ACER_KBB_SRC_LOAD]     = "load",
+	[ACER_KBB_SRC_SYSFS]    = "sysfs",
+	[ACER_KBB_SRC_KEY_ON]   = "key_on",
+	[ACER_KBB_SRC_AUTO_OFF] = "auto_off",
+	[ACER_KBB_SRC_PREWAKE]  = "prewake",
+	[ACER_KBB_SRC_PROFILE]  = "profile",
+};
+
+/* Binary layout of audit_bin: 48 bytes per record, host endianness */
+struct acer_kbb_audit_rec {
+	u64 ts_ns;                 /* ktime_get_ns(), CLOCK_MONOTONIC */
+	u64 latency_ns;            /* firmware write duration, 0 if none issued */
+	u32 seq;                   /* increments per record, detects ring wrap */
+	s32 pid;                   /* sysfs writer, 0 for internal sources or unknown */
+	char comm[TASK_COMM_LEN];
+	s16 old_brightness;        /* -1 = unknown */
+	s16 new_brightness;
+	u8 src;                    /* enum acer_kbb_src */
+	u8 fw_write;               /* 1 if a WMI write was issued */
+	s16 ret;                   /* WMI write result */
+};
+
+static DEFINE_SPINLOCK(audit_lock);
+static struct acer_kbb_audit_rec audit_ring[ACER_KBB_AUDIT_LEN];
+static unsigned int audit_head;  /* next slot to write */
+static unsigned int audit_count; /* valid records, <= ACER_KBB_AUDIT_LEN */
+static u32 audit_seq;
+
+/* pid/comm name the requester; writes applied from a worker pass them explicitly */
+static void __acer_kbb_audit(enum acer_kbb_src src, pid_t pid, const char *comm,
+			     int old_b, int new_b, bool fw_write, int ret, u64 latency_ns)
+{
+	struct acer_kbb_audit_rec *rec;
+	u64 now = ktime_get_ns();
+
+	spin_lock(&audit_lock);
+	rec = &audit_ring[audit_head];
+	rec->ts_ns = now;
+	rec->latency_ns = latency_ns;
+	rec->seq = audit_seq++;
+	rec->pid = pid;
+	strscpy(rec->comm, comm, sizeof(rec->comm));
+	rec->old_brightness = old_b;
+	rec->new_brightness = new_b;
+	rec->src = src;
+	rec->fw_write = fw_write;
+	rec->ret = ret;
+
+	audit_head = (audit_head + 1) % ACER_KBB_AUDIT_LEN;
+	if (audit_count < ACER_KBB_AUDIT_LEN)
+		audit_count++;
+	spin_unlock(&audit_lock);
+}
+
+/*
+ * Whether current is the task that asked for the change. Sets the LED core
+ * defers (brightness_set_blocking only, i.e. async_set=0) run on its kworker,
+ * which says nothing about the writer; those are logged with pid 0.
+ */
+static bool acer_kbb_requester_is_current(void)
+{
+	return in_task() && !(current->flags & PF_WQ_WORKER);
+}
+
+/* pid to record for work queued now and applied later from a worker */
+static pid_t acer_kbb_requester_pid(void)
+{
+	return acer_kbb_requester_is_current() ? task_pid_nr(current) : 0;
+}
+
+/* comm of a requester recorded by pid; "" if it has exited meanwhile */
+static void acer_kbb_requester_comm(pid_t pid, char comm[TASK_COMM_LEN])
+{
+	struct task_struct *task;
+
+	comm[0] = '\0';
+	if (!pid)
+		return;
+
+	rcu_read_lock();
+	task = pid_task(find_pid_ns(pid, &init_pid_ns), PIDTYPE_PID);
+	if (task)
+		strscpy(comm, task->comm, TASK_COMM_LEN);
+	rcu_read_unlock();
+}
+
+/* Change requested (and applied) by current, if it is a task other than a worker */
+static void acer_kbb_audit(enum acer_kbb_src src, int old_b, int new_b,
+			   bool fw_write, int ret, u64 latency_ns)
+{
+	if (acer_kbb_requester_is_current())
+		__acer_kbb_audit(src, task_pid_nr(current), current->comm,
+				 old_b, new_b, fw_write, ret, latency_ns);
+	else
+		__acer_kbb_audit(src, 0, "", old_b, new_b, fw_write, ret, latency_ns);
+}
+
+/* idx 0 is the oldest record; caller holds audit_lock */
+static struct acer_kbb_audit_rec *acer_kbb_audit_at(unsigned int idx)
+{
+	return &audit_ring[(audit_head + ACER_KBB_AUDIT_LEN - audit_count + idx) %
+			   ACER_KBB_AUDIT_LEN];
+}
+
+static int acer_kbb_audit_show(struct seq_file *m, void *unused)
+{
+	const struct acer_kbb_audit_rec *rec;
+	unsigned int i;
+
+	seq_puts(m, "# seq ts_ns src pid comm old new fw_write ret latency_us\n");
+
+	spin_lock(&audit_lock);
+	for (i = 0; i < audit_count; i++) {
+		rec = acer_kbb_audit_at(i);
+		seq_printf(m, "%u %llu %s %d %s %d %d %u %d %llu\n",
+			   rec->seq, rec->ts_ns, acer_kbb_src_names[rec->src],
+			   rec->pid, rec->comm[0] ? rec->comm : "-",
+			   rec->old_brightness, rec->new_brightness,
+			   rec->fw_write, rec->ret, rec->latency_ns / NSEC_PER_USEC);
+	}
+	spin_unlock(&audit_lock);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(acer_kbb_audit);
+
+static ssize_t acer_kbb_audit_bin_read(struct file *file, char __user *buf,
+				       size_t count, loff_t *ppos)
+{
+	struct acer_kbb_audit_rec rec;
+	size_t done = 0;
+	loff_t idx;
+
+	/* Whole records only; one copied out at a time to keep the lock short */
+	while (count - done >= sizeof(rec)) {
+		idx = *ppos / sizeof(rec);
+
+		spin_lock(&audit_lock);
+		if (idx >= audit_count) {
+			spin_unlock(&audit_lock);
+			break;
+		}
+		rec = *acer_kbb_audit_at(idx);
+		spin_unlock(&audit_lock);
+
+		if (copy_to_user(buf + done, &rec, sizeof(rec)))
+			return done ? done : -EFAULT;
+
+		done += sizeof(rec);
+		*ppos += sizeof(rec);
+	}
+
+	return done;
+}
+
+static const struct file_operations acer_kbb_audit_bin_fops = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.read = acer_kbb_audit_bin_read,
+	.llseek = default_llseek,
+};
+
+/* ---- Statistics ---- */
+
+/*
+ * Per-CPU counters and histograms: the hot paths only do this_cpu ops, the
+ * debugfs "metrics" file sums them on read (Prometheus text format).
+ */
+#define ACER_KBB_HIST_LEN 12 /* buckets, the last one is +Inf */
+
+struct acer_kbb_hist {
+	u64 bucket[ACER_KBB_HIST_LEN];
+	u64 sum;
+};
+
+struct acer_kbb_stats {
+	u64 keypresses;
+	u64 filtered_keys;
+	u64 filtered_repeats;
+	u64 fw_writes;
+	u64 fw_errors;
+	u64 prewakes;
+	struct acer_kbb_hist wmi_latency;  /* ns */
+	struct acer_kbb_hist key_to_lit;   /* ns */
+	struct acer_kbb_hist lit_session;  /* ns */
+};
+
+static DEFINE_PER_CPU(struct acer_kbb_stats, kbb_stats);
+
+/* Upper bounds in ns; metric labels (seconds) below */
+static const u64 acer_kbb_latency_bounds[ACER_KBB_HIST_LEN - 1] = {
+	100 * NSEC_PER_USEC, 250 * NSEC_PER_USEC, 500 * NSEC_PER_USEC,
+	1 * NSEC_PER_MSEC, 2500 * NSEC_PER_USEC, 5 * NSEC_PER_MSEC,
+	10 * NSEC_PER_MSEC, 25 * NSEC_PER_MSEC, 50 * NSEC_PER_MSEC,
+	100 * NSEC_PER_MSEC, 250 * NSEC_PER_MSEC,
+};
+
+static const char * const acer_kbb_latency_labels[ACER_KBB_HIST_LEN] = {
+	"0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005",
+	"0.01", "0.025", "0.05", "0.1", "0.25", "+Inf",
+};
+
+static const u64 acer_kbb_session_bounds[ACER_KBB_HIST_LEN - 1] = {
+	1 * NSEC_PER_SEC, 2 * NSEC_PER_SEC, 5 * NSEC_PER_SEC, 10 * NSEC_PER_SEC,
+	30 * NSEC_PER_SEC, 60 * NSEC_PER_SEC, 120 * NSEC_PER_SEC,
+	300 * NSEC_PER_SEC, 600 * NSEC_PER_SEC, 1800 * NSEC_PER_SEC,
+	3600 * NSEC_PER_SEC,
+};
+
+static const char * const acer_kbb_session_labels[ACER_KBB_HIST_LEN] = {
+	"1", "2", "5", "10", "30", "60", "120", "300", "600", "1800", "3600", "+Inf",
+};
+
+/* Firmware write failures in a row: 0 ok, below ACER_KBB_FAILING degraded */
+#define ACER_KBB_FAILING 3
+static atomic_t fw_consecutive_errors = ATOMIC_INIT(0);
+
+/* Time of the keypress that queued the pending turn-on, 0 if none */
+static atomic64_t turn_on_req_ns = ATOMIC64_INIT(0);
+/* Start of the current lit session, 0 while off */
+static u64 lit_since_ns;
+
+/* LED device kobject once registered, for poll() wakeups on the "lit" attribute */
+static struct kobject *led_kobj;
+
+#define acer_kbb_stat_inc(field) this_cpu_inc(kbb_stats.field)
+
+#define acer_kbb_hist_observe(field, bounds, ns)			\
+	do {								\
+		u64 __v = (ns);						\
+		int __i = 0;						\
+									\
+		while (__i < ACER_KBB_HIST_LEN - 1 && __v > (bounds)[__i]) \
+			__i++;						\
+		this_cpu_inc(kbb_stats.field.bucket[__i]);		\
+		this_cpu_add(kbb_stats.field.sum, __v);			\
+	} while (0)
+
+/* Lit-state transitions go through here so lit sessions can be measured */
+static void acer_kbb_set_lit(int lit)
+{
+	struct kobject *kobj;
+	u64 now, since;
+
+	/* The EC turns the light off on its own; we can't tell when */
+	if (fw_timeout_active)
+		return;
+
+	if (atomic_xchg(&is_lit, lit) == lit)
+		return;
+
+	kobj = READ_ONCE(led_kobj);
+	if (kobj)
+		sysfs_notify(kobj, NULL, "lit");
+
+	now = ktime_get_ns();
+	if (lit) {
+		WRITE_ONCE(lit_since_ns, now);
+		return;
+	}
+
+	since = READ_ONCE(lit_since_ns);
+	if (since) {
+		acer_kbb_hist_observe(lit_session, acer_kbb_session_bounds, now - since);
+		WRITE_ONCE(lit_since_ns, 0);
+	}
+}
+
+/* Called once a firmware write finished, with its result */
+static void acer_kbb_stat_fw_write(int ret, u64 latency_ns)
+{
+	acer_kbb_stat_inc(fw_writes);
+	acer_kbb_hist_observe(wmi_latency, acer_kbb_latency_bounds, latency_ns);
+
+	if (ret) {
+		acer_kbb_stat_inc(fw_errors);
+		atomic_inc(&fw_consecutive_errors);
+	} else if (atomic_read(&fw_consecutive_errors)) {
+		atomic_set(&fw_consecutive_errors, 0);
+	}
+}
+
+static void acer_kbb_stats_sum(struct acer_kbb_stats *sum)
+{
+	const struct acer_kbb_stats *s;
+	int cpu, i;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		s = per_cpu_ptr(&kbb_stats, cpu);
+		sum->keypresses += READ_ONCE(s->keypresses);
+		sum->filtered_keys += READ_ONCE(s->filtered_keys);
+		sum->filtered_repeats += READ_ONCE(s->filtered_repeats);
+		sum->fw_writes += READ_ONCE(s->fw_writes);
+		sum->fw_errors += READ_ONCE(s->fw_errors);
+		sum->prewakes += READ_ONCE(s->prewakes);
+		for (i = 0; i < ACER_KBB_HIST_LEN; i++) {
+			sum->wmi_latency.bucket[i] += READ_ONCE(s->wmi_latency.bucket[i]);
+			sum->key_to_lit.bucket[i] += READ_ONCE(s->key_to_lit.bucket[i]);
+			sum->lit_session.bucket[i] += READ_ONCE(s->lit_session.bucket[i]);
+		}
+		sum->wmi_latency.sum += READ_ONCE(s->wmi_latency.sum);
+		sum->key_to_lit.sum += READ_ONCE(s->key_to_lit.sum);
+		sum->lit_session.sum += READ_ONCE(s->lit_session.sum);
+	}
+}
+
+/* ---- Key filter ---- */
+
+/* Keypresses the notifier ignores; rebuilt whenever a filter parameter changes */
+static DECLARE_BITMAP(ignored_keys, KEY_CNT);
+
+/* Held keys generate autorepeat presses (down == 2) at the typematic rate */
+static bool ignore_autorepeat = true;
+module_param(ignore_autorepeat, bool, 0644);
+MODULE_PARM_DESC(ignore_autorepeat, "Ignore autorepeat of held keys");
+
+#define ACER_KBB_IGNORE_MEDIA     BIT(0)
+#define ACER_KBB_IGNORE_MODIFIERS BIT(1)
+
+static const unsigned short acer_kbb_media_keys[] = {
+	KEY_MUTE, KEY_VOLUMEDOWN, KEY_VOLUMEUP, KEY_MICMUTE,
+	KEY_PLAYPAUSE, KEY_PLAYCD, KEY_PAUSECD, KEY_STOPCD,
+	KEY_NEXTSONG, KEY_PREVIOUSSONG,
+	KEY_BRIGHTNESSDOWN, KEY_BRIGHTNESSUP,
+};
+
+static const unsigned short acer_kbb_modifier_keys[] = {
+	KEY_LEFTCTRL, KEY_RIGHTCTRL, KEY_LEFTSHIFT, KEY_RIGHTSHIFT,
+	KEY_LEFTALT, KEY_RIGHTALT, KEY_LEFTMETA, KEY_RIGHTMETA,
+};
+
+static int ignore_key_classes = ACER_KBB_IGNORE_MEDIA;
+static char ignore_keys[128];
+
+/* Runs under the module parameter lock, or from init before the notifier exists */
+static void acer_kbb_filter_rebuild(void)
+{
+	DECLARE_BITMAP(keys, KEY_CNT);
+	char list[sizeof(ignore_keys)], *cur = list, *tok;
+	unsigned int code;
+	int i;
+
+	bitmap_zero(keys, KEY_CNT);
+
+	if (ignore_key_classes & ACER_KBB_IGNORE_MEDIA)
+		for (i = 0; i < ARRAY_SIZE(acer_kbb_media_keys); i++)
+			__set_bit(acer_kbb_media_keys[i], keys);
+
+	/* A modifier alone does nothing; in a combo the other key lights up */
+	if (ignore_key_classes & ACER_KBB_IGNORE_MODIFIERS)
+		for (i = 0; i < ARRAY_SIZE(acer_kbb_modifier_keys); i++)
+			__set_bit(acer_kbb_modifier_keys[i], keys);
+
+	strscpy(list, ignore_keys, sizeof(list));
+	while ((tok = strsep(&cur, ", \n"))) {
+		if (!*tok)
+			continue;
+		if (kstrtouint(tok, 0, &code) || code >= KEY_CNT) {
+			pr_warn("ignore_keys: skipping invalid keycode '%s'\n", tok);
+			continue;
+		}
+		__set_bit(code, keys);
+	}
+
+	bitmap_copy(ignored_keys, keys, KEY_CNT);
+}
+
+static int acer_kbb_classes_set(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_int(val, kp);
+
+	if (!ret)
+		acer_kbb_filter_rebuild();
+	return ret;
+}
+
+static const struct kernel_param_ops acer_kbb_classes_ops = {
+	.set = acer_kbb_classes_set,
+	.get = param_get_int,
+};
+module_param_cb(ignore_key_classes, &acer_kbb_classes_ops, &ignore_key_classes, 0644);
+MODULE_PARM_DESC(ignore_key_classes, "Keypresses that don't light the keyboard: 1=media/volume/brightness keys, 2=modifiers alone (bitmask)");
+
+static int acer_kbb_keys_set(const char *val, const struct kernel_param *kp)
+{
+	if (strlen(val) >= sizeof(ignore_keys))
+		return -ENOSPC;
+
+	strscpy(ignore_keys, val, sizeof(ignore_keys));
+	acer_kbb_filter_rebuild();
+	return 0;
+}
+
+static const struct kernel_param_ops acer_kbb_keys_ops = {
+	.set = acer_kbb_keys_set,
+	.get = param_get_string,
+};
+
+static struct kparam_string acer_kbb_keys_str = {
+	.maxlen = sizeof(ignore_keys),
+	.string = ignore_keys,
+};
+module_param_cb(ignore_keys, &acer_kbb_keys_ops, &acer_kbb_keys_str, 0644);
+MODULE_PARM_DESC(ignore_keys, "Extra keycodes that don't light the keyboard (comma separated, see input-event-codes.h)");
+
+static int acer_kbb_filter_show(struct seq_file *m, void *unused)
+{
+	struct acer_kbb_stats sum;
+
+	acer_kbb_stats_sum(&sum);
+	seq_printf(m, "filtered_keys: %llu\n", sum.filtered_keys);
+	seq_printf(m, "filtered_repeats: %llu\n", sum.filtered_repeats);
+	seq_printf(m, "ignored: %*pbl\n", KEY_CNT, ignored_keys);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(acer_kbb_filter);
+
 /* ---- WMI write helpers ---- */
 
 static int acer_wmid_gaming_set_payload(const u8 payload[GAMING_KBBL_CONFIG_LEN])
@@ -100,6 +719,14 @@ static int acer_wmid_gaming_set_payload(const u8 payload[GAMING_KBBL_CONFIG_LEN]
 	struct acpi_buffer result = { ACPI_ALLOCATE_BUFFER, NULL };
 	acpi_status status;
 
+	if (mock_backend) {
+		int lat = READ_ONCE(mock_latency_us);
+
+		if (lat > 0)
+			fsleep(lat);
+		return 0;
+	}
+
 	status = wmi_evaluate_method(WMID_GUID4, 0, ACER_WMID_SET_GAMINGKBBL_METHODID,
 				     &input, &result);
 	if (ACPI_FAILURE(status)) {
@@ -111,67 +738,328 @@ static int acer_wmid_gaming_set_payload(const u8 payload[GAMING_KBBL_CONFIG_LEN]
 	return 0;
 }
 
+/* auto_off_ms in effect: power-saving profiles may shorten it */
+static int acer_kbb_auto_off_ms(void)
+{
+	int ms = READ_ONCE(auto_off_ms);
+	int ps = READ_ONCE(powersave_auto_off_ms);
+
+	if (READ_ONCE(powersave) && ps > 0 && (ms <= 0 || ps < ms))
+		return ps;
+	return ms;
+}
+
+/* Timeout byte for the EC; a derived one follows auto_off_ms and the profile */
+static u8 acer_kbb_fw_timeout_s(void)
+{
+	if (!fw_timeout_derived)
+		return fw_timeout_s;
+	return clamp(DIV_ROUND_UP(max(acer_kbb_auto_off_ms(), 1), MSEC_PER_SEC), 1, 255);
+}
+
 static int acer_kbb_brightness_apply(u8 brightness)
 {
 	u8 payload[GAMING_KBBL_CONFIG_LEN] = { 0 };
 
 	payload[2] = brightness;                    /* 0-100 */
-	payload[9] = (u8)(payload9_value ? 1 : 0);  /* 0/1 */
+	/* 0/1; power-saving profiles force the static (no effect) mode */
+	payload[9] = (u8)(payload9_value || READ_ONCE(powersave) ? 1 : 0);
+	if (fw_timeout_active)
+		payload[fw_timeout_idx] = acer_kbb_fw_timeout_s();
 
 	return acer_wmid_gaming_set_payload(payload);
 }
 
+/*
+ * Same as acer_kbb_brightness_apply(), also reporting how long the write took.
+ * All writes go through here so the metrics see every one.
+ */
+static int acer_kbb_brightness_apply_timed(u8 brightness, u64 *latency_ns)
+{
+	ktime_t t0 = ktime_get();
+	int ret;
+
+	ret = acer_kbb_brightness_apply(brightness);
+	*latency_ns = ktime_to_ns(ktime_sub(ktime_get(), t0));
+	acer_kbb_stat_fw_write(ret, *latency_ns);
+
+	return ret;
+}
+
+/*
+ * Hand auto-off to the EC: one write with the timeout byte set. On failure
+ * the byte is dropped again and the caller keeps the software path.
+ */
+static bool acer_kbb_fw_timeout_enable(void)
+{
+	u64 lat;
+	int ret;
+
+	if (fw_timeout_idx >= GAMING_KBBL_CONFIG_LEN || fw_timeout_idx == 2 ||
+	    fw_timeout_idx == 9) {
+		pr_warn("fw_timeout_idx=%d is not a free payload byte; using software auto-off\n",
+			fw_timeout_idx);
+		return false;
+	}
+
+	/* A derived value is kept only for the load message */
+	fw_timeout_derived = fw_timeout_s <= 0;
+	fw_timeout_s = fw_timeout_derived ? acer_kbb_fw_timeout_s() : clamp(fw_timeout_s, 1, 255);
+
+	fw_timeout_active = true;
+	ret = acer_kbb_brightness_apply_timed(cached_brightness, &lat);
+	acer_kbb_audit(ACER_KBB_SRC_LOAD, -1, cached_brightness, true, ret, lat);
+	if (ret) {
+		fw_timeout_active = false;
+		pr_warn("Firmware timeout write failed: %d; using software auto-off\n", ret);
+		return false;
+	}
+
+	/* is_lit stays 0 and unused: "lit" reads -1 (unknown) in this mode */
+	atomic_set(&applied_brightness, cached_brightness);
+	return true;
+}
+
+/* ---- Firmware latency calibration ---- */
+
+/*
+ * Rewrites the payload the firmware already has, so the user sees nothing.
+ * Without apply_on_load that is the "off" assumed at load, which the first
+ * keypress would have to write anyway. Each write is audited like any other.
+ */
+static void acer_kbb_calibrate(void)
+{
+	u64 lat, sum = 0, lo = U64_MAX, hi = 0;
+	int i, applied, ret = 0;
+
+	mutex_lock(&kbb_mutex);
+	applied = atomic_read(&applied_brightness);
+	for (i = 0; applied >= 0 && i < ACER_KBB_CALIB_WRITES; i++) {
+		ret = acer_kbb_brightness_apply_timed(applied, &lat);
+		acer_kbb_audit(ACER_KBB_SRC_LOAD, applied, applied, true, ret, lat);
+		if (ret)
+			break;
+		sum += lat;
+		lo = min(lo, lat);
+		hi = max(hi, lat);
+	}
+	mutex_unlock(&kbb_mutex);
+
+	if (applied < 0)
+		return;
+	if (ret) {
+		pr_warn("Calibration write failed: %d\n", ret);
+		return;
+	}
+
+	calib_min_us = div_u64(lo, NSEC_PER_USEC);
+	calib_max_us = div_u64(hi, NSEC_PER_USEC);
+	calib_avg_us = div_u64(sum, ACER_KBB_CALIB_WRITES * NSEC_PER_USEC);
+	calib_debounce_ms = DIV_ROUND_UP(2 * calib_avg_us, USEC_PER_MSEC);
+
+	pr_info("Firmware latency: min=%uus avg=%uus max=%uus -> debounce floor %ums\n",
+		calib_min_us, calib_avg_us, calib_max_us, calib_debounce_ms);
+}
+
+/* ---- Typing-rate estimator ---- */
+
+static void acer_kbb_typing_update(unsigned long gap_jiffies)
+{
+	u32 gap_us = gap_jiffies >= usecs_to_jiffies(ACER_KBB_GAP_CAP_US) ?
+		     ACER_KBB_GAP_CAP_US : jiffies_to_usecs(gap_jiffies);
+	u32 ewma = READ_ONCE(kbd_gap_ewma_us);
+
+	WRITE_ONCE(kbd_gap_ewma_us, ewma - (ewma >> 3) + (gap_us >> 3));
+}
+
+static bool acer_kbb_typing_burst(void)
+{
+	return READ_ONCE(kbd_gap_ewma_us) <= USEC_PER_SEC / ACER_KBB_BURST_KEYS_PER_S;
+}
+
+/* Keys per second, times 100 */
+static u32 acer_kbb_typing_rate_x100(void)
+{
+	u32 gap = READ_ONCE(kbd_gap_ewma_us);
+
+	return gap ? 100 * USEC_PER_SEC / gap : 0;
+}
+
+/*
+ * Effective off->on debounce window. Adaptive mode uses the typical gap
+ * between keys (so one keystroke storm causes one apply) and drops to zero
+ * during bursts, where the light should follow the typing closely.
+ */
+static unsigned int acer_kbb_debounce_ms(void)
+{
+	int fixed = READ_ONCE(on_debounce_ms);
+	u32 window;
+
+	if (fixed >= 0)
+		return fixed;
+	if (acer_kbb_typing_burst())
+		window = 0;
+	else
+		window = min_t(u32, READ_ONCE(kbd_gap_ewma_us) / USEC_PER_MSEC,
+			       ACER_KBB_DEBOUNCE_MAX_MS);
+
+	/* A window shorter than one firmware write cannot coalesce anything */
+	return max(window, calib_debounce_ms);
+}
+
+static int acer_kbb_typing_show(struct seq_file *m, void *unused)
+{
+	u32 rate = acer_kbb_typing_rate_x100();
+
+	seq_printf(m, "rate_keys_per_s: %u.%02u\n", rate / 100, rate % 100);
+	seq_printf(m, "gap_ewma_us: %u\n", READ_ONCE(kbd_gap_ewma_us));
+	seq_printf(m, "burst: %d\n", acer_kbb_typing_burst());
+	seq_printf(m, "debounce_ms: %u\n", acer_kbb_debounce_ms());
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(acer_kbb_typing);
+
+/* ---- Power profile ---- */
+
+static const char * const acer_kbb_powersave_profiles[] = {
+	"low-power", "quiet", "cool",
+};
+
+/* Brightness actually sent to firmware for the user's cached value */
+static u8 acer_kbb_capped(u8 b)
+{
+	if (READ_ONCE(powersave))
+		return min_t(u8, b, clamp(powersave_max_brightness, 0, 100));
+	return b;
+}
+
+/*
+ * Switch power-saving lighting on/off. Everything changes under kbb_mutex and
+ * the firmware is written at most once, only if the light is on.
+ */
+static int acer_kbb_set_powersave(bool on)
+{
+	int ret = 0, old;
+	u8 target;
+	u64 lat;
+
+	mutex_lock(&kbb_mutex);
+	if (powersave == on) {
+		mutex_unlock(&kbb_mutex);
+		return 0;
+	}
+	WRITE_ONCE(powersave, on);
+
+	old = atomic_read(&applied_brightness);
+	target = acer_kbb_capped(cached_brightness);
+
+	/* payload[9] may change too, so rewrite whenever the light is on */
+	if (old <= 0) {
+		mutex_unlock(&kbb_mutex);
+		return 0;
+	}
+
+	ret = acer_kbb_brightness_apply_timed(target, &lat);
+	if (!ret)
+		atomic_set(&applied_brightness, target);
+	mutex_unlock(&kbb_mutex);
+
+	acer_kbb_audit(ACER_KBB_SRC_PROFILE, old, target, true, ret, lat);
+
+	return ret;
+}
+
 /* ---- Work functions ---- */
 
 static void acer_turn_on_workfn(struct work_struct *work)
 {
 	u8 b;
-	int ret;
-	unsigned long now = jiffies;
+	int ret, old;
+	u64 lat;
+	unsigned long now = jiffies, until;
+	s64 reason = atomic64_read(&turn_on_reason);
+	enum acer_kbb_src src = (u32)reason;
+	pid_t pid = reason >> 32;
+	char comm[TASK_COMM_LEN];
+	unsigned int debounce_ms = acer_kbb_debounce_ms();
+	u64 req_ns = atomic64_xchg(&turn_on_req_ns, 0);
 
 	/* If already on, skip */
 	if (atomic_read(&is_lit))
 		return;
 
-	/* Optional debounce */
-	if (on_debounce_ms > 0 &&
-	    time_before(now, last_on_apply_jiffies + msecs_to_jiffies(on_debounce_ms)))
+	/*
+	 * Optional debounce. Inside the window the turn-on is deferred to its
+	 * end, not dropped: with auto_off_ms below the window, the key press
+	 * may be the only one for a while.
+	 */
+	until = last_on_apply_jiffies + msecs_to_jiffies(debounce_ms);
+	if (debounce_ms > 0 && time_before(now, until)) {
+		atomic64_cmpxchg(&turn_on_req_ns, 0, req_ns);
+		queue_delayed_work(acer_hi_wq, &turn_on_work, until - now);
 		return;
+	}
 
 	mutex_lock(&kbb_mutex);
-	b = cached_brightness;
+	b = acer_kbb_capped(cached_brightness);
 
 	/*
 	 * If cached brightness is 0, turning "on" does nothing useful.
-	 * Keep is_lit = 0, and skip firmware call.
+	 * Keep is_lit = 0, and skip firmware call. Same while unloading, where
+	 * the LED core's final "off" must stay the last write.
 	 */
-	if (b == 0) {
+	if (b == 0 || kbb_exiting) {
 		mutex_unlock(&kbb_mutex);
 		return;
 	}
 
 	/* If firmware already has this brightness (as far as we know), skip */
-	if (atomic_read(&applied_brightness) == b) {
-		atomic_set(&is_lit, 1);
+	old = atomic_read(&applied_brightness);
+	if (old == b) {
+		acer_kbb_set_lit(1);
 		mutex_unlock(&kbb_mutex);
+		acer_kbb_requester_comm(pid, comm);
+		__acer_kbb_audit(src, pid, comm, old, b, false, 0, 0);
 		return;
 	}
 
-	ret = acer_kbb_brightness_apply(b);
+	ret = acer_kbb_brightness_apply_timed(b, &lat);
 	if (!ret) {
-		atomic_set(&is_lit, 1);
+		acer_kbb_set_lit(1);
 		atomic_set(&applied_brightness, b);
 		last_on_apply_jiffies = now;
 	}
 	mutex_unlock(&kbb_mutex);
 
+	acer_kbb_requester_comm(pid, comm);
+	__acer_kbb_audit(src, pid, comm, old, b, true, ret, lat);
+
+	if (!ret && req_ns)
+		acer_kbb_hist_observe(key_to_lit, acer_kbb_latency_bounds,
+				      ktime_get_ns() - req_ns);
+
 	if (ret)
 		pr_debug("turn_on apply failed: %d\n", ret);
 }
 
 static void acer_turn_off_workfn(struct work_struct *work)
 {
-	int ret;
+	int ret, old;
+	u64 lat;
+	int off_ms = acer_kbb_auto_off_ms();
+	unsigned long deadline = READ_ONCE(kbd_last_key_jiffies) +
+				 msecs_to_jiffies(max(off_ms, 0));
+	unsigned long now = jiffies;
+
+	/*
+	 * During typing bursts the notifier does not re-arm this timer per key;
+	 * if keys arrived since it was queued, sleep for the remainder instead.
+	 */
+	if (off_ms > 0 && time_before(now, deadline)) {
+		queue_delayed_work(acer_wq, &turn_off_work, deadline - now);
+		return;
+	}
 
 	/* If already off, skip */
 	if (!atomic_read(&is_lit) && atomic_read(&applied_brightness) == 0)
@@ -181,28 +1069,116 @@ static void acer_turn_off_workfn(struct work_struct *work)
 
 	/* If we already believe firmware is at 0, skip */
 	if (atomic_read(&applied_brightness) == 0) {
-		atomic_set(&is_lit, 0);
+		acer_kbb_set_lit(0);
 		mutex_unlock(&kbb_mutex);
 		return;
 	}
 
-	ret = acer_kbb_brightness_apply(0);
+	old = atomic_read(&applied_brightness);
+	ret = acer_kbb_brightness_apply_timed(0, &lat);
 	if (!ret) {
-		atomic_set(&is_lit, 0);
+		acer_kbb_set_lit(0);
 		atomic_set(&applied_brightness, 0);
 	}
 	mutex_unlock(&kbb_mutex);
 
+	acer_kbb_audit(ACER_KBB_SRC_AUTO_OFF, old, 0, true, ret, lat);
+
 	if (ret)
 		pr_debug("turn_off apply failed: %d\n", ret);
 }
 
+/* ---- Keyboard activity: LED trigger + notifier chain ---- */
+
+int acer_kbd_activity_register_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&kbd_activity_chain, nb);
+}
+EXPORT_SYMBOL_GPL(acer_kbd_activity_register_notifier);
+
+int acer_kbd_activity_unregister_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&kbd_activity_chain, nb);
+}
+EXPORT_SYMBOL_GPL(acer_kbd_activity_unregister_notifier);
+
+static void acer_kbd_idle_workfn(struct work_struct *work)
+{
+	unsigned long timeout = msecs_to_jiffies(max(kbd_activity_timeout_ms, 0));
+	unsigned long deadline = READ_ONCE(kbd_last_key_jiffies) + timeout;
+	unsigned long now = jiffies;
+	unsigned long flags;
+
+	/*
+	 * Keypresses only store a timestamp, so the timer is not re-armed per key.
+	 * If a key arrived since this was queued, sleep for the remainder.
+	 */
+	if (time_before(now, deadline)) {
+		queue_delayed_work(acer_wq, &kbd_idle_work, deadline - now);
+		return;
+	}
+
+	spin_lock_irqsave(&kbd_activity_lock, flags);
+	atomic_set(&kbd_active, 0);
+
+	/*
+	 * Pairs with the barrier in acer_kbd_activity_mark(): a key that still
+	 * saw kbd_active set is seen here, and the idle edge is called off.
+	 */
+	smp_mb();
+	deadline = READ_ONCE(kbd_last_key_jiffies) + timeout;
+	if (time_before(now, deadline)) {
+		atomic_set(&kbd_active, 1);
+		spin_unlock_irqrestore(&kbd_activity_lock, flags);
+		queue_delayed_work(acer_wq, &kbd_idle_work, deadline - now);
+		return;
+	}
+
+	led_trigger_event(kbd_activity_trig, LED_OFF);
+	atomic_notifier_call_chain(&kbd_activity_chain, ACER_KBD_ACTIVITY_IDLE, NULL);
+	spin_unlock_irqrestore(&kbd_activity_lock, flags);
+}
+
+/*
+ * Called for every keypress after kbd_last_key_jiffies is stored; cheap
+ * unless this is the idle->active edge.
+ */
+static void acer_kbd_activity_mark(void)
+{
+	unsigned long flags;
+
+	/* Timestamp before kbd_active; see acer_kbd_idle_workfn() */
+	smp_mb();
+	if (atomic_read(&kbd_active))
+		return;
+
+	/* An idle edge being delivered finishes first */
+	spin_lock_irqsave(&kbd_activity_lock, flags);
+	if (!atomic_read(&kbd_active)) {
+		atomic_set(&kbd_active, 1);
+		led_trigger_event(kbd_activity_trig, LED_FULL);
+		atomic_notifier_call_chain(&kbd_activity_chain, ACER_KBD_ACTIVITY_ACTIVE, NULL);
+		queue_delayed_work(acer_wq, &kbd_idle_work,
+				   msecs_to_jiffies(max(kbd_activity_timeout_ms, 0)));
+	}
+	spin_unlock_irqrestore(&kbd_activity_lock, flags);
+}
+
+/* Anyone listening to keyboard activity (checked per key in firmware timeout mode) */
+static bool acer_kbd_activity_wanted(void)
+{
+	return rcu_access_pointer(kbd_activity_chain.head) ||
+	       (kbd_activity_trig && !list_empty(&kbd_activity_trig->led_cdevs));
+}
+
 /* ---- Keyboard notifier: reacts to real keypresses ---- */
 
 static int acer_kbb_keyboard_notify(struct notifier_block *nb,
 				    unsigned long action, void *data)
 {
 	struct keyboard_notifier_param *param = data;
+	unsigned long now, gap;
+	int off_ms;
 
 	if (action != KBD_KEYCODE)
 		return NOTIFY_OK;
@@ -211,83 +1187,429 @@ static int acer_kbb_keyboard_notify(struct notifier_block *nb,
 	if (!param->down)
 		return NOTIFY_OK;
 
+	/* Filtered keys must not cost anything beyond this point */
+	if (param->value < KEY_CNT && test_bit(param->value, ignored_keys)) {
+		acer_kbb_stat_inc(filtered_keys);
+		return NOTIFY_OK;
+	}
+	if (param->down == 2 && ignore_autorepeat) {
+		acer_kbb_stat_inc(filtered_repeats);
+		return NOTIFY_OK;
+	}
+
+	acer_kbb_stat_inc(keypresses);
+
+	now = jiffies;
+
+	/* The EC handles the light; only keyboard activity subscribers need us */
+	if (fw_timeout_active) {
+		if (acer_kbd_activity_wanted()) {
+			WRITE_ONCE(kbd_last_key_jiffies, now);
+			acer_kbd_activity_mark();
+		}
+		return NOTIFY_OK;
+	}
+
+	gap = now - READ_ONCE(kbd_last_key_jiffies);
+	acer_kbb_typing_update(gap);
+	WRITE_ONCE(kbd_last_key_jiffies, now);
+	/* Nobody listening: no idle timer per typing session */
+	if (acer_kbd_activity_wanted())
+		acer_kbd_activity_mark();
+
 	/*
 	 * Turn on only if currently off.
 	 * This removes the expensive "WMI write on every keypress" behavior.
 	 */
-	if (!atomic_read(&is_lit))
-		queue_delayed_work(acer_wq, &turn_on_work, 0);
+	if (!atomic_read(&is_lit)) {
+		atomic64_set(&turn_on_reason, ACER_KBB_SRC_KEY_ON);
+		atomic64_cmpxchg(&turn_on_req_ns, 0, ktime_get_ns());
+		queue_delayed_work(acer_hi_wq, &turn_on_work, 0);
+	}
 
 	/*
 	 * Restart auto-off timer with mod_delayed_work().
 	 * This is preferable to cancel_delayed_work()+schedule_delayed_work().
+	 * During a burst a pending timer is left alone; it re-checks the last
+	 * keypress time when it fires.
 	 */
-	if (auto_off_ms > 0)
-		mod_delayed_work(acer_wq, &turn_off_work, msecs_to_jiffies(auto_off_ms));
+	off_ms = acer_kbb_auto_off_ms();
+	if (off_ms > 0 &&
+	    !(acer_kbb_typing_burst() && delayed_work_pending(&turn_off_work)))
+		mod_delayed_work(acer_wq, &turn_off_work, msecs_to_jiffies(off_ms));
 
 	return NOTIFY_OK;
 }
 
-/* ---- LED class device ---- */
+/* ---- Pre-wake: lid open, resume, userspace poke ---- */
 
-static int acer_kbb_led_set(struct led_classdev *cdev, enum led_brightness value)
+/* Same as a keypress for the backlight, without feeding keyboard activity */
+static void acer_kbb_prewake(int trigger)
 {
-	u8 b;
+	int off_ms = acer_kbb_auto_off_ms();
+
+	if (!(READ_ONCE(prewake) & trigger) || !acer_wq || fw_timeout_active ||
+	    READ_ONCE(kbb_exiting))
+		return;
+
+	acer_kbb_stat_inc(prewakes);
+
+	if (!atomic_read(&is_lit)) {
+		/* A prewake attribute write names its writer; lid/resume record 0 */
+		atomic64_set(&turn_on_reason,
+			     ((s64)acer_kbb_requester_pid() << 32) | ACER_KBB_SRC_PREWAKE);
+		queue_delayed_work(acer_hi_wq, &turn_on_work, 0);
+	}
+
+	if (off_ms > 0)
+		mod_delayed_work(acer_wq, &turn_off_work, msecs_to_jiffies(off_ms));
+}
+
+static void acer_lid_event(struct input_handle *handle, unsigned int type,
+			   unsigned int code, int value)
+{
+	/* SW_LID: 1 = closed, 0 = open */
+	if (type == EV_SW && code == SW_LID && value == 0)
+		acer_kbb_prewake(ACER_KBB_PREWAKE_LID);
+}
+
+static int acer_lid_connect(struct input_handler *handler, struct input_dev *dev,
+			    const struct input_device_id *id)
+{
+	struct input_handle *handle;
 	int ret;
 
+	handle = kzalloc(sizeof(*handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = KBUILD_MODNAME "_lid";
+
+	ret = input_register_handle(handle);
+	if (ret)
+		goto err_free;
+
+	ret = input_open_device(handle);
+	if (ret)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return ret;
+}
+
+static void acer_lid_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id acer_lid_ids[] = {
+	{
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT | INPUT_DEVICE_ID_MATCH_SWBIT,
+		.evbit = { BIT_MASK(EV_SW) },
+		.swbit = { [BIT_WORD(SW_LID)] = BIT_MASK(SW_LID) },
+	},
+	{ }
+};
+
+static struct input_handler acer_lid_handler = {
+	.name = KBUILD_MODNAME "_lid",
+	.event = acer_lid_event,
+	.connect = acer_lid_connect,
+	.disconnect = acer_lid_disconnect,
+	.id_table = acer_lid_ids,
+};
+
+static int acer_kbb_pm_notify(struct notifier_block *nb, unsigned long action, void *data)
+{
+	if (action == PM_POST_SUSPEND || action == PM_POST_HIBERNATION)
+		acer_kbb_prewake(ACER_KBB_PREWAKE_RESUME);
+
+	return NOTIFY_DONE;
+}
+
+/* ---- LED class device ---- */
+
+static int acer_kbb_led_apply(enum led_brightness value, pid_t pid, const char *comm)
+{
+	u8 b, t;
+	int ret, old;
+	u64 lat;
+
 	/* led_brightness is 0..255; our sysfs max is 100 */
 	b = (value > 100) ? 100 : (u8)value;
+	t = acer_kbb_capped(b); /* what firmware gets; b stays the user's intent */
 
 	/*
 	 * If we're currently "on" and already applied this brightness, skip.
 	 * If b==0 and already off, skip.
 	 */
-	if (atomic_read(&applied_brightness) == b) {
+	old = atomic_read(&applied_brightness);
+	if (old == t) {
 		/* Still update cached_brightness so keypress uses latest intent */
 		mutex_lock(&kbb_mutex);
 		cached_brightness = b;
 		mutex_unlock(&kbb_mutex);
 
-		if (b == 0)
-			atomic_set(&is_lit, 0);
-		else
-			atomic_set(&is_lit, 1);
+		acer_kbb_set_lit(t ? 1 : 0);
 
+		__acer_kbb_audit(ACER_KBB_SRC_SYSFS, pid, comm, old, t, false, 0, 0);
 		return 0;
 	}
 
 	mutex_lock(&kbb_mutex);
-	ret = acer_kbb_brightness_apply(b);
+	old = atomic_read(&applied_brightness);
+	ret = acer_kbb_brightness_apply_timed(t, &lat);
 	if (!ret) {
 		cached_brightness = b;              /* keypress uses this */
-		atomic_set(&applied_brightness, b); /* what we believe firmware has */
-		atomic_set(&is_lit, b ? 1 : 0);
+		atomic_set(&applied_brightness, t); /* what we believe firmware has */
+		acer_kbb_set_lit(t ? 1 : 0);
 	}
 	mutex_unlock(&kbb_mutex);
 
+	__acer_kbb_audit(ACER_KBB_SRC_SYSFS, pid, comm, old, t, true, ret, lat);
+
 	return ret;
 }
 
+static int acer_kbb_led_set(struct led_classdev *cdev, enum led_brightness value)
+{
+	/* A synchronous set supersedes any older target still waiting in set_work */
+	atomic64_set(&set_req, -1);
+
+	if (acer_kbb_requester_is_current())
+		return acer_kbb_led_apply(value, task_pid_nr(current), current->comm);
+
+	return acer_kbb_led_apply(value, 0, "");
+}
+
+/* May be called in atomic context: no locks, no sleeping */
+static void acer_kbb_led_set_nb(struct led_classdev *cdev, enum led_brightness value)
+{
+	pid_t pid = acer_kbb_requester_pid();
+
+	atomic64_set(&set_req, ((s64)pid << 32) | min_t(u32, value, 100));
+
+	/* Already pending: it picks up the new target, like the LED core's work does */
+	queue_work(acer_wq, &set_work);
+}
+
+static void acer_set_workfn(struct work_struct *work)
+{
+	char comm[TASK_COMM_LEN];
+	s64 req = atomic64_xchg(&set_req, -1);
+	pid_t pid = req >> 32;
+	int value = (u32)req;
+	int ret;
+
+	if (req < 0)
+		return;
+
+	acer_kbb_requester_comm(pid, comm);
+
+	/* Nobody is waiting for the result; the audit log keeps it */
+	ret = acer_kbb_led_apply(value, pid, comm);
+	if (ret)
+		pr_debug("brightness set failed: %d\n", ret);
+}
+
 static enum led_brightness acer_kbb_led_get(struct led_classdev *cdev)
 {
 	/* No firmware readback; report last cached value */
 	return cached_brightness;
 }
 
+/* Any write lights the keyboard ahead of the first keypress (unlock hooks etc.) */
+static ssize_t prewake_store(struct device *dev, struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	acer_kbb_prewake(ACER_KBB_PREWAKE_UNLOCK);
+	return count;
+}
+static DEVICE_ATTR_WO(prewake);
+
+/*
+ * Takes the same names as /sys/firmware/acpi/platform_profile, so a power
+ * daemon (or a hook on that file) can forward profile changes as they happen.
+ */
+static ssize_t platform_profile_store(struct device *dev, struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	int ret;
+
+	ret = acer_kbb_set_powersave(sysfs_match_string(acer_kbb_powersave_profiles, buf) >= 0);
+
+	return ret ? ret : count;
+}
+
+static ssize_t platform_profile_show(struct device *dev, struct device_attribute *attr,
+				     char *buf)
+{
+	return sysfs_emit(buf, "%s\n", READ_ONCE(powersave) ? "powersave" : "normal");
+}
+static DEVICE_ATTR_RW(platform_profile);
+
+/* 1 while the light is on, -1 if unknown; poll()able (POLLPRI) for state changes */
+static ssize_t lit_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%d\n", fw_timeout_active ? -1 : atomic_read(&is_lit));
+}
+static DEVICE_ATTR_RO(lit);
+
+/* Calibration results (0 = not calibrated) */
+static ssize_t fw_latency_min_us_show(struct device *dev, struct device_attribute *attr,
+				      char *buf)
+{
+	return sysfs_emit(buf, "%u\n", calib_min_us);
+}
+static DEVICE_ATTR_RO(fw_latency_min_us);
+
+static ssize_t fw_latency_avg_us_show(struct device *dev, struct device_attribute *attr,
+				      char *buf)
+{
+	return sysfs_emit(buf, "%u\n", calib_avg_us);
+}
+static DEVICE_ATTR_RO(fw_latency_avg_us);
+
+static ssize_t fw_latency_max_us_show(struct device *dev, struct device_attribute *attr,
+				      char *buf)
+{
+	return sysfs_emit(buf, "%u\n", calib_max_us);
+}
+static DEVICE_ATTR_RO(fw_latency_max_us);
+
+/* Debounce window currently in effect (fixed, adaptive, or calibrated floor) */
+static ssize_t debounce_ms_show(struct device *dev, struct device_attribute *attr,
+				char *buf)
+{
+	return sysfs_emit(buf, "%u\n", acer_kbb_debounce_ms());
+}
+static DEVICE_ATTR_RO(debounce_ms);
+
+static struct attribute *acer_kbb_led_attrs[] = {
+	&dev_attr_prewake.attr,
+	&dev_attr_platform_profile.attr,
+	&dev_attr_lit.attr,
+	&dev_attr_fw_latency_min_us.attr,
+	&dev_attr_fw_latency_avg_us.attr,
+	&dev_attr_fw_latency_max_us.attr,
+	&dev_attr_debounce_ms.attr,
+	NULL
+};
+ATTRIBUTE_GROUPS(acer_kbb_led);
+
 static struct led_classdev acer_kbb_led = {
 	.name = "acer::kbd_backlight",
 	.brightness_set_blocking = acer_kbb_led_set,
 	.brightness_get = acer_kbb_led_get,
 	.max_brightness = 100,
+	.groups = acer_kbb_led_groups,
 };
 
+/* ---- Metrics (Prometheus text format) ---- */
+
+static void acer_kbb_metric(struct seq_file *m, const char *name, const char *type,
+			    const char *help, u64 value)
+{
+	const char *suffix = strcmp(type, "counter") ? "" : "_total";
+
+	/* Prometheus text format: the family name carries _total too */
+	seq_printf(m, "# TYPE acer_kbb_%s%s %s\n", name, suffix, type);
+	seq_printf(m, "# HELP acer_kbb_%s%s %s\n", name, suffix, help);
+	seq_printf(m, "acer_kbb_%s%s %llu\n", name, suffix, value);
+}
+
+static void acer_kbb_metric_hist(struct seq_file *m, const char *name, const char *help,
+				 const struct acer_kbb_hist *h, const char * const *labels)
+{
+	u64 cum = 0, secs;
+	u32 rem;
+	int i;
+
+	seq_printf(m, "# TYPE acer_kbb_%s_seconds histogram\n", name);
+	seq_printf(m, "# HELP acer_kbb_%s_seconds %s\n", name, help);
+	for (i = 0; i < ACER_KBB_HIST_LEN; i++) {
+		cum += h->bucket[i];
+		seq_printf(m, "acer_kbb_%s_seconds_bucket{le=\"%s\"} %llu\n", name, labels[i], cum);
+	}
+	secs = div_u64_rem(h->sum, NSEC_PER_SEC, &rem);
+	seq_printf(m, "acer_kbb_%s_seconds_sum %llu.%09u\n", name, secs, rem);
+	seq_printf(m, "acer_kbb_%s_seconds_count %llu\n", name, cum);
+}
+
+static int acer_kbb_metrics_show(struct seq_file *m, void *unused)
+{
+	static const char * const health[] = { "ok", "degraded", "failing" };
+	struct acer_kbb_stats sum;
+	int errs = atomic_read(&fw_consecutive_errors);
+	int state = errs == 0 ? 0 : errs < ACER_KBB_FAILING ? 1 : 2;
+	int i;
+
+	acer_kbb_stats_sum(&sum);
+
+	acer_kbb_metric(m, "keypresses", "counter", "Keypresses seen by the notifier", sum.keypresses);
+	acer_kbb_metric(m, "filtered_keys", "counter", "Keypresses dropped by the key filter",
+			sum.filtered_keys);
+	acer_kbb_metric(m, "filtered_repeats", "counter", "Autorepeat presses dropped",
+			sum.filtered_repeats);
+	acer_kbb_metric(m, "prewakes", "counter", "Pre-wake events acted on", sum.prewakes);
+	acer_kbb_metric(m, "fw_writes", "counter", "Firmware (WMI) writes issued", sum.fw_writes);
+	acer_kbb_metric(m, "fw_errors", "counter", "Firmware (WMI) writes that failed", sum.fw_errors);
+
+	acer_kbb_metric_hist(m, "wmi_latency", "Firmware write duration",
+			     &sum.wmi_latency, acer_kbb_latency_labels);
+	acer_kbb_metric_hist(m, "keypress_to_lit", "Keypress to light on, when off",
+			     &sum.key_to_lit, acer_kbb_latency_labels);
+	acer_kbb_metric_hist(m, "lit_session", "Time the light stayed on",
+			     &sum.lit_session, acer_kbb_session_labels);
+
+	/* One series per state, 1 for the current one (no stateset type in the text format) */
+	seq_puts(m, "# TYPE acer_kbb_health gauge\n# HELP acer_kbb_health Firmware write health\n");
+	for (i = 0; i < ARRAY_SIZE(health); i++)
+		seq_printf(m, "acer_kbb_health{state=\"%s\"} %d\n", health[i], i == state);
+
+	acer_kbb_metric(m, "fw_consecutive_errors", "gauge", "Failed firmware writes in a row", errs);
+	/* Unknown while the EC owns auto-off; absent rather than wrong */
+	if (!fw_timeout_active)
+		acer_kbb_metric(m, "lit", "gauge", "Keyboard light on", atomic_read(&is_lit));
+	acer_kbb_metric(m, "brightness", "gauge", "Cached (user) brightness", cached_brightness);
+	acer_kbb_metric(m, "applied_brightness", "gauge", "Brightness believed applied in firmware",
+			max(atomic_read(&applied_brightness), 0));
+	acer_kbb_metric(m, "auto_off_ms", "gauge", "Auto-off delay in effect",
+			fw_timeout_active ? acer_kbb_fw_timeout_s() * MSEC_PER_SEC :
+					    max(acer_kbb_auto_off_ms(), 0));
+	acer_kbb_metric(m, "debounce_ms", "gauge", "Off->on debounce window in effect",
+			acer_kbb_debounce_ms());
+	acer_kbb_metric(m, "typing_rate_x100", "gauge", "Estimated keypresses per second x100",
+			acer_kbb_typing_rate_x100());
+	acer_kbb_metric(m, "powersave", "gauge", "Power-saving profile lighting active",
+			READ_ONCE(powersave));
+	acer_kbb_metric(m, "fw_timeout_active", "gauge", "Auto-off handled by firmware",
+			fw_timeout_active);
+	acer_kbb_metric(m, "fw_latency_avg_us", "gauge", "Calibrated firmware latency (0 if not run)",
+			calib_avg_us);
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(acer_kbb_metrics);
+
 /* ---- Init/Exit ---- */
 
 static int __init acer_kbb_init(void)
 {
 	int ret;
 
-	if (!wmi_has_guid(WMID_GUID4)) {
+	if (mock_backend) {
+		pr_info("mock_backend=1: firmware writes are simulated\n");
+	} else if (!wmi_has_guid(WMID_GUID4)) {
 		pr_err("WMID_GUID4 not present; Acer gaming WMI interface unavailable\n");
 		return -ENODEV;
 	}
@@ -304,13 +1626,20 @@ static int __init acer_kbb_init(void)
 	if (initial_brightness > 100)
 		initial_brightness = 100;
 
-	if (on_debounce_ms < 0)
-		on_debounce_ms = 0;
+	if (on_debounce_ms < -1)
+		on_debounce_ms = -1;
+
+	if (kbd_activity_timeout_ms < 0)
+		kbd_activity_timeout_ms = 0;
+
+	/* Defaults don't go through the parameter setters */
+	acer_kbb_filter_rebuild();
 
 	cached_brightness = (u8)initial_brightness;
 	atomic_set(&is_lit, 0);
 	atomic_set(&applied_brightness, -1);
 	last_on_apply_jiffies = 0;
+	kbd_last_key_jiffies = jiffies;
 
 	/*
 	 * Create dedicated unbound workqueue.
@@ -320,16 +1649,41 @@ static int __init acer_kbb_init(void)
 	if (!acer_wq)
 		return -ENOMEM;
 
+	acer_hi_wq = alloc_workqueue("acer_brightness_hi",
+				     WQ_UNBOUND | WQ_FREEZABLE | WQ_HIGHPRI, 1);
+	if (!acer_hi_wq) {
+		destroy_workqueue(acer_wq);
+		acer_wq = NULL;
+		return -ENOMEM;
+	}
+
 	INIT_DELAYED_WORK(&turn_on_work, acer_turn_on_workfn);
 	INIT_DELAYED_WORK(&turn_off_work, acer_turn_off_workfn);
+	INIT_DELAYED_WORK(&kbd_idle_work, acer_kbd_idle_workfn);
+	INIT_WORK(&set_work, acer_set_workfn);
+
+	if (async_set)
+		acer_kbb_led.brightness_set = acer_kbb_led_set_nb;
+
+	led_trigger_register_simple("kbd-activity", &kbd_activity_trig);
 
 	ret = led_classdev_register(NULL, &acer_kbb_led);
 	if (ret) {
 		pr_err("Failed to register LED class device: %d\n", ret);
+		led_trigger_unregister_simple(kbd_activity_trig);
+		destroy_workqueue(acer_hi_wq);
+		acer_hi_wq = NULL;
 		destroy_workqueue(acer_wq);
 		acer_wq = NULL;
 		return ret;
 	}
+	WRITE_ONCE(led_kobj, &acer_kbb_led.dev->kobj);
+
+	if (fw_timeout_idx >= 0 && acer_kbb_fw_timeout_enable()) {
+		/* The EC sees every keypress itself; the notifier only feeds kbd-activity */
+		pr_info("Firmware idle timeout %ds (payload[%d]); software auto-off and pre-wake disabled\n",
+			fw_timeout_s, fw_timeout_idx);
+	}
 
 	/* Register keyboard notifier for real keypress events */
 	kbd_nb.notifier_call = acer_kbb_keyboard_notify;
@@ -339,14 +1693,32 @@ static int __init acer_kbb_init(void)
 		/* Keep driver usable via sysfs even without notifier */
 	}
 
+	if (fw_timeout_active)
+		goto out_applied;
+
+	/* Pre-wake sources; the module stays usable without them */
+	ret = input_register_handler(&acer_lid_handler);
+	if (ret)
+		pr_warn("input_register_handler failed: %d (lid pre-wake disabled)\n", ret);
+	else
+		lid_handler_registered = true;
+
+	pm_nb.notifier_call = acer_kbb_pm_notify;
+	ret = register_pm_notifier(&pm_nb);
+	if (ret)
+		pr_warn("register_pm_notifier failed: %d (resume pre-wake disabled)\n", ret);
+
 	if (apply_on_load) {
-		ret = acer_kbb_brightness_apply(cached_brightness);
+		u64 lat;
+
+		ret = acer_kbb_brightness_apply_timed(cached_brightness, &lat);
 		if (ret) {
 			pr_warn("Initial brightness apply failed: %d\n", ret);
 		} else {
 			atomic_set(&applied_brightness, cached_brightness);
-			atomic_set(&is_lit, cached_brightness ? 1 : 0);
+			acer_kbb_set_lit(cached_brightness ? 1 : 0);
 		}
+		acer_kbb_audit(ACER_KBB_SRC_LOAD, -1, cached_brightness, true, ret, lat);
 	} else {
 		/*
 		 * We don't know actual firmware state. Assume "off" to prevent needless writes.
@@ -356,6 +1728,19 @@ static int __init acer_kbb_init(void)
 		atomic_set(&is_lit, 0);
 	}
 
+out_applied:
+	/* Skipped if the applied state is still unknown (a failed load write) */
+	if (calibrate)
+		acer_kbb_calibrate();
+
+	/* Debugfs is optional; failures here are not fatal */
+	acer_dbg_dir = debugfs_create_dir(KBUILD_MODNAME, NULL);
+	debugfs_create_file("audit", 0400, acer_dbg_dir, NULL, &acer_kbb_audit_fops);
+	debugfs_create_file("audit_bin", 0400, acer_dbg_dir, NULL, &acer_kbb_audit_bin_fops);
+	debugfs_create_file("typing", 0400, acer_dbg_dir, NULL, &acer_kbb_typing_fops);
+	debugfs_create_file("filter", 0400, acer_dbg_dir, NULL, &acer_kbb_filter_fops);
+	debugfs_create_file("metrics", 0400, acer_dbg_dir, NULL, &acer_kbb_metrics_fops);
+
 	pr_info("Loaded. Set brightness via /sys/class/leds/%s/brightness (0-100).\n",
 		acer_kbb_led.name);
 	pr_info("Keypress turns on if off; auto-off after %dms. Workqueue=WQ_UNBOUND.\n",
@@ -368,16 +1753,41 @@ static int __init acer_kbb_init(void)
 
 static void __exit acer_kbb_exit(void)
 {
-	/* Stop any pending work */
+	debugfs_remove_recursive(acer_dbg_dir);
+	acer_dbg_dir = NULL;
+
+	unregister_keyboard_notifier(&kbd_nb);
+	unregister_pm_notifier(&pm_nb);
+	if (lid_handler_registered)
+		input_unregister_handler(&acer_lid_handler);
+
+	/* A turn-on already holding kbb_mutex finishes before the LED goes off */
+	mutex_lock(&kbb_mutex);
+	WRITE_ONCE(kbb_exiting, true);
+	mutex_unlock(&kbb_mutex);
+
+	/*
+	 * The prewake attribute can queue work until the LED device is gone.
+	 * Unregistering turns the LED off through set_work; let that write finish.
+	 */
+	WRITE_ONCE(led_kobj, NULL);
+	led_classdev_unregister(&acer_kbb_led);
+	if (acer_wq)
+		flush_work(&set_work);
+
+	/* Stop any pending work (after everything that could re-queue it) */
 	if (acer_wq) {
 		cancel_delayed_work_sync(&turn_on_work);
 		cancel_delayed_work_sync(&turn_off_work);
+		cancel_delayed_work_sync(&kbd_idle_work);
 	}
 
-	unregister_keyboard_notifier(&kbd_nb);
-
-	led_classdev_unregister(&acer_kbb_led);
+	led_trigger_unregister_simple(kbd_activity_trig);
 
+	if (acer_hi_wq) {
+		destroy_workqueue(acer_hi_wq);
+		acer_hi_wq = NULL;
+	}
 	if (acer_wq) {
 		destroy_workqueue(acer_wq);
 		acer_wq = NULL;
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * acer_brightness.h
+ *
+ * In-kernel interface exported by acer_brightness for keyboard activity.
+ * Subscribers are called from atomic context (keyboard notifier or workqueue
+ * with no locks a callback may depend on), at most once per transition.
+ * Activity is reported in firmware idle timeout mode (fw_timeout_idx) too.
+ */
+
+#ifndef _ACER_BRIGHTNESS_H
+#define _ACER_BRIGHTNESS_H
+
+#include <linux/notifier.h>
+
+/* Notifier actions */
+#define ACER_KBD_ACTIVITY_ACTIVE 1 /* first keypress after idle */
+#define ACER_KBD_ACTIVITY_IDLE   0 /* no keypress for kbd_activity_timeout_ms */
+
+int acer_kbd_activity_register_notifier(struct notifier_block *nb);
+int acer_kbd_activity_unregister_notifier(struct notifier_block *nb);
+
+#endif /* _ACER_BRIGHTNESS_H */
@@ -0,0 +1,302 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * acerkbb.c
+ *
+ * Userspace client library for acer_brightness (see acerkbb.h).
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "acerkbb.h"
+
+#define LED_DIR   "/sys/class/leds/acer::kbd_backlight/"
+#define PARAM_DIR "/sys/module/acer_brightness/parameters/"
+#define METRICS   "/sys/kernel/debug/acer_brightness/metrics"
+#define PLATFORM_PROFILE "/sys/firmware/acpi/platform_profile"
+
+/* Config fields in struct order, with the parameter each maps to */
+static const char * const param_names[] = {
+	NULL, /* brightness goes through the LED device */
+	"auto_off_ms",
+	"on_debounce_ms",
+	"prewake",
+	"ignore_autorepeat",
+	"ignore_key_classes",
+	"powersave_max_brightness",
+	"powersave_auto_off_ms",
+	"kbd_activity_timeout_ms",
+};
+
+#define NR_FIELDS (sizeof(struct acerkbb_config) / sizeof(int))
+
+/* The config is walked as an int array, one param_names entry per field */
+_Static_assert(sizeof(struct acerkbb_config) % sizeof(int) == 0,
+	       "struct acerkbb_config must only hold ints");
+_Static_assert(sizeof(param_names) / sizeof(param_names[0]) == NR_FIELDS,
+	       "param_names must list every struct acerkbb_config field");
+
+struct acerkbb {
+	int brightness_fd;
+	int lit_fd;
+	int prewake_fd;
+	int profile_fd;
+	int param_fd[NR_FIELDS];
+};
+
+void acerkbb_config_init(struct acerkbb_config *cfg)
+{
+	int *f = (int *)cfg;
+	size_t i;
+
+	for (i = 0; i < NR_FIELDS; i++)
+		f[i] = ACERKBB_UNSET;
+}
+
+struct acerkbb *acerkbb_open(void)
+{
+	struct acerkbb *h;
+	size_t i;
+
+	h = calloc(1, sizeof(*h));
+	if (!h)
+		return NULL;
+
+	h->brightness_fd = open(LED_DIR "brightness", O_RDWR | O_CLOEXEC);
+	if (h->brightness_fd < 0) {
+		free(h);
+		return NULL;
+	}
+	h->lit_fd = open(LED_DIR "lit", O_RDONLY | O_CLOEXEC);
+	h->prewake_fd = open(LED_DIR "prewake", O_WRONLY | O_CLOEXEC);
+	h->profile_fd = open(LED_DIR "platform_profile", O_WRONLY | O_CLOEXEC);
+
+	/* Parameters are opened on first use */
+	for (i = 0; i < NR_FIELDS; i++)
+		h->param_fd[i] = -1;
+
+	return h;
+}
+
+void acerkbb_close(struct acerkbb *h)
+{
+	size_t i;
+
+	if (!h)
+		return;
+
+	close(h->brightness_fd);
+	if (h->lit_fd >= 0)
+		close(h->lit_fd);
+	if (h->prewake_fd >= 0)
+		close(h->prewake_fd);
+	if (h->profile_fd >= 0)
+		close(h->profile_fd);
+	for (i = 0; i < NR_FIELDS; i++)
+		if (h->param_fd[i] >= 0)
+			close(h->param_fd[i]);
+	free(h);
+}
+
+const char *acerkbb_transport(const struct acerkbb *h)
+{
+	(void)h;
+	return "sysfs";
+}
+
+/* sysfs attributes are rewritten from offset 0 each time */
+static int put_int(int fd, int val)
+{
+	char buf[16];
+	int len = snprintf(buf, sizeof(buf), "%d", val);
+
+	if (fd < 0)
+		return -ENOENT;
+	return pwrite(fd, buf, len, 0) == len ? 0 : -errno;
+}
+
+static int get_int(int fd)
+{
+	char buf[16];
+	ssize_t n;
+
+	if (fd < 0)
+		return -ENOENT;
+	n = pread(fd, buf, sizeof(buf) - 1, 0);
+	if (n <= 0)
+		return n < 0 ? -errno : -EIO;
+	buf[n] = '\0';
+	return atoi(buf);
+}
+
+int acerkbb_set_brightness(struct acerkbb *h, int brightness)
+{
+	return put_int(h->brightness_fd, brightness);
+}
+
+int acerkbb_get_brightness(struct acerkbb *h)
+{
+	return get_int(h->brightness_fd);
+}
+
+int acerkbb_get_lit(struct acerkbb *h)
+{
+	int lit = get_int(h->lit_fd);
+
+	/* -1: firmware idle timeout mode, the module doesn't know */
+	return lit == -1 ? -ENODATA : lit;
+}
+
+int acerkbb_prewake(struct acerkbb *h)
+{
+	return put_int(h->prewake_fd, 1);
+}
+
+int acerkbb_set_platform_profile(struct acerkbb *h, const char *profile)
+{
+	size_t len = strlen(profile);
+
+	if (h->profile_fd < 0)
+		return -ENOENT;
+	return pwrite(h->profile_fd, profile, len, 0) == (ssize_t)len ? 0 : -errno;
+}
+
+int acerkbb_follow_platform_profile(struct acerkbb *h)
+{
+	struct pollfd pfd = { .events = POLLPRI | POLLERR };
+	char buf[64];
+	ssize_t n;
+	int ret;
+
+	pfd.fd = open(PLATFORM_PROFILE, O_RDONLY | O_CLOEXEC);
+	if (pfd.fd < 0)
+		return -errno;
+
+	/* The firmware sysfs_notify()s the file on every change, e.g. Fn+F or a daemon */
+	for (;;) {
+		/* The read also re-arms POLLPRI */
+		n = pread(pfd.fd, buf, sizeof(buf) - 1, 0);
+		if (n <= 0) {
+			ret = n < 0 ? -errno : -EIO;
+			break;
+		}
+		buf[n] = '\0';
+
+		ret = acerkbb_set_platform_profile(h, buf);
+		if (ret)
+			break;
+
+		if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+			ret = -errno;
+			break;
+		}
+	}
+
+	close(pfd.fd);
+	return ret;
+}
+
+int acerkbb_configure(struct acerkbb *h, const struct acerkbb_config *cfg)
+{
+	const int *f = (const int *)cfg;
+	char path[128];
+	size_t i;
+	int ret;
+
+	for (i = 0; i < NR_FIELDS; i++) {
+		/*
+		 * Always written: a value cached here goes stale as soon as another
+		 * process (or the module itself) changes it, and the module already
+		 * skips firmware writes that would change nothing.
+		 */
+		if (f[i] == ACERKBB_UNSET)
+			continue;
+
+		if (!param_names[i]) {
+			ret = acerkbb_set_brightness(h, f[i]);
+		} else {
+			if (h->param_fd[i] < 0) {
+				snprintf(path, sizeof(path), PARAM_DIR "%s", param_names[i]);
+				h->param_fd[i] = open(path, O_WRONLY | O_CLOEXEC);
+			}
+			ret = put_int(h->param_fd[i], f[i]);
+		}
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+int acerkbb_wait_event(struct acerkbb *h, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = h->lit_fd, .events = POLLPRI | POLLERR };
+	int ret;
+
+	if (h->lit_fd < 0)
+		return -ENOENT;
+
+	/* sysfs poll needs a read first to arm the notification */
+	ret = acerkbb_get_lit(h);
+	if (ret == -ENODATA)
+		return ret;
+
+	ret = poll(&pfd, 1, timeout_ms);
+	if (ret < 0)
+		return -errno;
+	if (ret == 0)
+		return -ETIMEDOUT;
+
+	return acerkbb_get_lit(h);
+}
+
+int acerkbb_read_stats(struct acerkbb *h, struct acerkbb_stats *st)
+{
+	static const struct {
+		const char *name;
+		size_t off;
+	} fields[] = {
+		{ "acer_kbb_keypresses_total", offsetof(struct acerkbb_stats, keypresses) },
+		{ "acer_kbb_filtered_keys_total", offsetof(struct acerkbb_stats, filtered_keys) },
+		{ "acer_kbb_filtered_repeats_total", offsetof(struct acerkbb_stats, filtered_repeats) },
+		{ "acer_kbb_prewakes_total", offsetof(struct acerkbb_stats, prewakes) },
+		{ "acer_kbb_fw_writes_total", offsetof(struct acerkbb_stats, fw_writes) },
+		{ "acer_kbb_fw_errors_total", offsetof(struct acerkbb_stats, fw_errors) },
+		{ "acer_kbb_fw_consecutive_errors", offsetof(struct acerkbb_stats, fw_consecutive_errors) },
+		{ "acer_kbb_wmi_latency_seconds_count", offsetof(struct acerkbb_stats, wmi_latency_count) },
+	};
+	char line[256], name[128];
+	double val;
+	size_t i;
+	FILE *f;
+
+	(void)h;
+	memset(st, 0, sizeof(*st));
+
+	f = fopen(METRICS, "r");
+	if (!f)
+		return -errno;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#' || sscanf(line, "%127s %lf", name, &val) != 2)
+			continue;
+		if (!strcmp(name, "acer_kbb_wmi_latency_seconds_sum")) {
+			st->wmi_latency_sum_s = val;
+			continue;
+		}
+		for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+			if (!strcmp(name, fields[i].name))
+				*(uint64_t *)((char *)st + fields[i].off) = (uint64_t)val;
+	}
+
+	fclose(f);
+	return 0;
+}
@@ -0,0 +1,79 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * acerkbb.h
+ *
+ * Userspace client library for acer_brightness:
+ * - Discovers the LED device and module parameters once, keeps the files open
+ * - Batched configuration: only fields that are set are written, through
+ *   descriptors kept open
+ * - State events through poll() on the "lit" attribute
+ * - Platform profile forwarding, so power daemons don't have to know about us
+ * - Stats parsed from the debugfs "metrics" file (root only)
+ *
+ * The module only exposes sysfs today; acerkbb_transport() reports what is in
+ * use so callers (and the benchmark) don't depend on it.
+ */
+
+#ifndef ACERKBB_H
+#define ACERKBB_H
+
+#include <stdint.h>
+
+#define ACERKBB_UNSET (-2) /* leave this field unchanged */
+
+struct acerkbb;
+
+/* Fields set to ACERKBB_UNSET are skipped; see README "Configuration" */
+struct acerkbb_config {
+	int brightness;
+	int auto_off_ms;
+	int on_debounce_ms;
+	int prewake;
+	int ignore_autorepeat;
+	int ignore_key_classes;
+	int powersave_max_brightness;
+	int powersave_auto_off_ms;
+	int kbd_activity_timeout_ms;
+};
+
+struct acerkbb_stats {
+	uint64_t keypresses;
+	uint64_t filtered_keys;
+	uint64_t filtered_repeats;
+	uint64_t prewakes;
+	uint64_t fw_writes;
+	uint64_t fw_errors;
+	uint64_t fw_consecutive_errors;
+	uint64_t wmi_latency_count;
+	double wmi_latency_sum_s;
+};
+
+void acerkbb_config_init(struct acerkbb_config *cfg);
+
+/* NULL with errno set if the module is not loaded */
+struct acerkbb *acerkbb_open(void);
+void acerkbb_close(struct acerkbb *h);
+const char *acerkbb_transport(const struct acerkbb *h);
+
+/* Setters return 0, getters the value; errors are a negative errno */
+int acerkbb_set_brightness(struct acerkbb *h, int brightness);
+int acerkbb_get_brightness(struct acerkbb *h);
+int acerkbb_get_lit(struct acerkbb *h); /* -ENODATA in firmware idle timeout mode */
+int acerkbb_prewake(struct acerkbb *h);
+int acerkbb_configure(struct acerkbb *h, const struct acerkbb_config *cfg);
+
+/* Passes a platform profile name (e.g. "low-power") to the power-saving lighting */
+int acerkbb_set_platform_profile(struct acerkbb *h, const char *profile);
+
+/*
+ * Forwards /sys/firmware/acpi/platform_profile now and on every change until
+ * an error occurs; only returns with a negative errno.
+ */
+int acerkbb_follow_platform_profile(struct acerkbb *h);
+
+/* Waits for a lit state change and returns the new state (0/1), or -ETIMEDOUT */
+int acerkbb_wait_event(struct acerkbb *h, int timeout_ms);
+
+int acerkbb_read_stats(struct acerkbb *h, struct acerkbb_stats *st);
+
+#endif /* ACERKBB_H */
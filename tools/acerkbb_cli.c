@@ -0,0 +1,270 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * acerkbb_cli.c
+ *
+ * Command line client for acer_brightness built on libacerkbb:
+ *   acerkbb get | set <0-100> | prewake
+ *   acerkbb config key=value ...      (batched, see struct acerkbb_config)
+ *   acerkbb watch [timeout_ms]        (prints lit state changes)
+ *   acerkbb follow-profile            (forwards platform_profile changes, runs until killed)
+ *   acerkbb stats                     (root, needs debugfs)
+ *   acerkbb bench [ops]               (per-op cost of each access method)
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "acerkbb.h"
+
+#define LED_BRIGHTNESS "/sys/class/leds/acer::kbd_backlight/brightness"
+#define PARAM_DIR      "/sys/module/acer_brightness/parameters/"
+
+static const struct {
+	const char *key;
+	size_t off;
+} config_keys[] = {
+	{ "brightness", offsetof(struct acerkbb_config, brightness) },
+	{ "auto_off_ms", offsetof(struct acerkbb_config, auto_off_ms) },
+	{ "on_debounce_ms", offsetof(struct acerkbb_config, on_debounce_ms) },
+	{ "prewake", offsetof(struct acerkbb_config, prewake) },
+	{ "ignore_autorepeat", offsetof(struct acerkbb_config, ignore_autorepeat) },
+	{ "ignore_key_classes", offsetof(struct acerkbb_config, ignore_key_classes) },
+	{ "powersave_max_brightness", offsetof(struct acerkbb_config, powersave_max_brightness) },
+	{ "powersave_auto_off_ms", offsetof(struct acerkbb_config, powersave_auto_off_ms) },
+	{ "kbd_activity_timeout_ms", offsetof(struct acerkbb_config, kbd_activity_timeout_ms) },
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int cmd_config(struct acerkbb *h, int argc, char **argv)
+{
+	struct acerkbb_config cfg;
+	char *eq;
+	size_t k;
+	int i;
+
+	acerkbb_config_init(&cfg);
+
+	for (i = 0; i < argc; i++) {
+		eq = strchr(argv[i], '=');
+		if (!eq) {
+			fprintf(stderr, "expected key=value: %s\n", argv[i]);
+			return 1;
+		}
+		*eq = '\0';
+		for (k = 0; k < sizeof(config_keys) / sizeof(config_keys[0]); k++)
+			if (!strcmp(argv[i], config_keys[k].key))
+				break;
+		if (k == sizeof(config_keys) / sizeof(config_keys[0])) {
+			fprintf(stderr, "unknown key: %s\n", argv[i]);
+			return 1;
+		}
+		*(int *)((char *)&cfg + config_keys[k].off) = atoi(eq + 1);
+	}
+
+	i = acerkbb_configure(h, &cfg);
+	if (i) {
+		fprintf(stderr, "configure: %s\n", strerror(-i));
+		return 1;
+	}
+	return 0;
+}
+
+static int cmd_watch(struct acerkbb *h, int timeout_ms)
+{
+	int lit;
+
+	for (;;) {
+		lit = acerkbb_wait_event(h, timeout_ms);
+		if (lit == -ETIMEDOUT)
+			return 0;
+		if (lit < 0) {
+			fprintf(stderr, "watch: %s\n", strerror(-lit));
+			return 1;
+		}
+		printf("lit=%d\n", lit);
+		fflush(stdout);
+	}
+}
+
+static int cmd_stats(struct acerkbb *h)
+{
+	struct acerkbb_stats st;
+	int ret = acerkbb_read_stats(h, &st);
+
+	if (ret) {
+		fprintf(stderr, "stats: %s (root and debugfs needed)\n", strerror(-ret));
+		return 1;
+	}
+
+	printf("keypresses:            %llu\n", (unsigned long long)st.keypresses);
+	printf("filtered_keys:         %llu\n", (unsigned long long)st.filtered_keys);
+	printf("filtered_repeats:      %llu\n", (unsigned long long)st.filtered_repeats);
+	printf("prewakes:              %llu\n", (unsigned long long)st.prewakes);
+	printf("fw_writes:             %llu\n", (unsigned long long)st.fw_writes);
+	printf("fw_errors:             %llu\n", (unsigned long long)st.fw_errors);
+	printf("fw_consecutive_errors: %llu\n", (unsigned long long)st.fw_consecutive_errors);
+	if (st.wmi_latency_count)
+		printf("wmi_latency_avg_us:    %.1f\n",
+		       st.wmi_latency_sum_s * 1e6 / st.wmi_latency_count);
+	return 0;
+}
+
+/* ---- bench: what every "echo > sysfs" tool does vs. the library ---- */
+
+static int echo_int(const char *path, int val)
+{
+	char buf[16];
+	int len = snprintf(buf, sizeof(buf), "%d", val);
+	int fd = open(path, O_WRONLY);
+	int ret;
+
+	if (fd < 0)
+		return -errno;
+	ret = write(fd, buf, len) == len ? 0 : -errno;
+	close(fd);
+	return ret;
+}
+
+static void bench_report(const char *name, uint64_t ns, int ops)
+{
+	printf("%-34s %9.2f us/op\n", name, ns / 1e3 / ops);
+}
+
+static int cmd_bench(struct acerkbb *h, int ops)
+{
+	static const char * const batch[] = {
+		PARAM_DIR "auto_off_ms", PARAM_DIR "kbd_activity_timeout_ms",
+		PARAM_DIR "powersave_auto_off_ms", PARAM_DIR "on_debounce_ms",
+	};
+	struct acerkbb_config cfg;
+	int orig[4] = { 0 }, i, j, err = 0;
+	int brightness = acerkbb_get_brightness(h);
+	uint64_t t0;
+
+	printf("transport=%s ops=%d\n", acerkbb_transport(h), ops);
+
+	/* Values alternate so neither side can skip a write */
+	t0 = now_ns();
+	for (i = 0; i < ops; i++)
+		err |= echo_int(LED_BRIGHTNESS, 40 + (i & 1));
+	bench_report("brightness: open/write/close", now_ns() - t0, ops);
+
+	t0 = now_ns();
+	for (i = 0; i < ops; i++)
+		err |= acerkbb_set_brightness(h, 40 + (i & 1));
+	bench_report("brightness: libacerkbb", now_ns() - t0, ops);
+
+	/* Leave the light as found, like the parameters below */
+	if (brightness >= 0)
+		err |= acerkbb_set_brightness(h, brightness);
+
+	/* Remember what the batch touches so the run leaves the config as found */
+	for (j = 0; j < 4; j++) {
+		char buf[16] = "";
+		int fd = open(batch[j], O_RDONLY);
+
+		if (fd >= 0) {
+			if (read(fd, buf, sizeof(buf) - 1) < 0)
+				buf[0] = '\0';
+			close(fd);
+		}
+		orig[j] = atoi(buf);
+	}
+
+	t0 = now_ns();
+	for (i = 0; i < ops; i++)
+		for (j = 0; j < 4; j++)
+			err |= echo_int(batch[j], orig[j] + (i & 1));
+	bench_report("config x4: open/write/close", now_ns() - t0, ops);
+
+	acerkbb_config_init(&cfg);
+	t0 = now_ns();
+	for (i = 0; i < ops; i++) {
+		cfg.auto_off_ms = orig[0] + (i & 1);
+		cfg.kbd_activity_timeout_ms = orig[1] + (i & 1);
+		cfg.powersave_auto_off_ms = orig[2] + (i & 1);
+		cfg.on_debounce_ms = orig[3] + (i & 1);
+		err |= acerkbb_configure(h, &cfg);
+	}
+	bench_report("config x4: libacerkbb batch", now_ns() - t0, ops);
+
+	for (j = 0; j < 4; j++)
+		echo_int(batch[j], orig[j]);
+
+	if (err)
+		fprintf(stderr, "warning: some writes failed (root needed for parameters)\n");
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Usage: acerkbb get | set <0-100> | prewake | config key=value... |\n"
+		"               watch [timeout_ms] | follow-profile | stats | bench [ops]\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct acerkbb *h;
+	int ret = 0;
+
+	if (argc < 2) {
+		usage();
+		return 1;
+	}
+
+	h = acerkbb_open();
+	if (!h) {
+		perror("acer_brightness not found");
+		return 1;
+	}
+
+	if (!strcmp(argv[1], "get")) {
+		ret = acerkbb_get_brightness(h);
+		if (ret >= 0) {
+			printf("%d\n", ret);
+			ret = 0;
+		}
+	} else if (!strcmp(argv[1], "set") && argc == 3) {
+		ret = acerkbb_set_brightness(h, atoi(argv[2]));
+	} else if (!strcmp(argv[1], "prewake")) {
+		ret = acerkbb_prewake(h);
+	} else if (!strcmp(argv[1], "config")) {
+		ret = cmd_config(h, argc - 2, argv + 2);
+	} else if (!strcmp(argv[1], "watch")) {
+		ret = cmd_watch(h, argc > 2 ? atoi(argv[2]) : -1);
+	} else if (!strcmp(argv[1], "follow-profile")) {
+		ret = acerkbb_follow_platform_profile(h);
+	} else if (!strcmp(argv[1], "stats")) {
+		ret = cmd_stats(h);
+	} else if (!strcmp(argv[1], "bench")) {
+		ret = cmd_bench(h, argc > 2 ? atoi(argv[2]) : 1000);
+	} else {
+		usage();
+		ret = 1;
+	}
+
+	if (ret < 0) {
+		fprintf(stderr, "%s: %s\n", argv[1], strerror(-ret));
+		ret = 1;
+	}
+
+	acerkbb_close(h);
+	return ret;
+}
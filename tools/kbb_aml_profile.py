@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+"""
+kbb_aml_profile.py
+
+Breaks down where a gaming WMI method 20 write spends its time:
+- module:      write latency measured by acer_brightness (debugfs audit_bin)
+- AML method:  ACPICA "Method Begin/End" trace points of the WMI wrapper
+- opcodes:     "Opcode Begin/End" trace points inside it, slowest listed first;
+               EC accesses show up as the field reads/writes that cause them
+- marshalling: module latency minus AML method time (WMI core + ACPICA
+               argument setup and return object handling)
+
+Needs a kernel with CONFIG_ACPI_DEBUG (ACPICA trace points) and root. Works
+the same in a VM booted with a custom SSDT; --log parses a dmesg captured
+elsewhere (e.g. from a CI guest) instead of running the writes here.
+
+  sudo tools/kbb_aml_profile.py --writes 20
+  tools/kbb_aml_profile.py --log guest-dmesg.txt --audit guest-audit.bin
+"""
+
+import argparse
+import glob
+import os
+import re
+import struct
+import sys
+import time
+
+WMID_GUID4 = "7A4DDFE7-5B5D-40B4-8595-4408E0CC7F56"
+ACPI_PARAMS = "/sys/module/acpi/parameters/"
+LED_BRIGHTNESS = "/sys/class/leds/acer::kbd_backlight/brightness"
+AUDIT_BIN = "/sys/kernel/debug/acer_brightness/audit_bin"
+
+# struct acer_kbb_audit_rec (see acer_brightness.c)
+AUDIT_FMT = "=QQIi16shhBBh"
+AUDIT_SIZE = struct.calcsize(AUDIT_FMT)
+
+ACPI_EXECUTER = 0x80      # trace_debug_layer
+ACPI_LV_TRACE_POINT = 0x10  # trace_debug_level
+
+# acpi_ex_trace_point(), see Documentation/firmware-guide/acpi/method-tracing.rst:
+# "[ 1234.567890] ... ex_trace_point : Method Begin [0x...:\_SB.WMID.WMBH] execution."
+# ACPICA has a Region kind too, but never emits it.
+TRACE_RE = re.compile(r"^\[\s*(?P<ts>\d+\.\d+)\].*?(?P<kind>Method|Opcode) (?P<edge>Begin|End) "
+                      r"\[[^:\]]*:(?P<name>[^\]]*)\] execution")
+
+
+def wmi_method_path():
+    """ACPI path of the WMxx method that services WMID_GUID4 method calls."""
+    for dev in glob.glob("/sys/bus/wmi/devices/*"):
+        try:
+            with open(os.path.join(dev, "guid")) as f:
+                if f.read().strip().upper() != WMID_GUID4:
+                    continue
+            with open(os.path.join(dev, "object_id")) as f:
+                obj = f.read().strip()
+            with open(os.path.join(dev, "..", "firmware_node", "path")) as f:
+                parent = f.read().strip()
+        except OSError:
+            continue
+        return "%s.WM%s" % (parent, obj)
+    return None
+
+
+def pw(name, value):
+    with open(ACPI_PARAMS + name, "w") as f:
+        f.write(value)
+
+
+def trace_enable(method, opcodes):
+    pw("trace_debug_layer", hex(ACPI_EXECUTER))
+    pw("trace_debug_level", hex(ACPI_LV_TRACE_POINT))
+    pw("trace_method_name", method)
+    pw("trace_state", "opcode" if opcodes else "method")
+
+
+def trace_disable():
+    pw("trace_state", "disable")
+
+
+def kmsg_open():
+    """/dev/kmsg positioned after the newest record; the log itself is left alone."""
+    fd = os.open("/dev/kmsg", os.O_RDONLY | os.O_NONBLOCK)
+    os.lseek(fd, 0, os.SEEK_END)
+    return fd
+
+
+def kmsg_read(fd):
+    """Records logged since kmsg_open(), as dmesg-style "[sec.usec] msg" lines."""
+    lines = []
+    while True:
+        try:
+            rec = os.read(fd, 8192)
+        except BlockingIOError:
+            break
+        except BrokenPipeError:
+            continue  # records overwritten before we read them; go on with the next
+        if not rec:
+            break
+        # "pri,seq,ts_usec,flags;message\n KEY=value..."
+        head, _, msg = rec.decode(errors="replace").partition(";")
+        ts_us = int(head.split(",")[2])
+        lines.append("[%5d.%06d] %s" % (ts_us // 1000000, ts_us % 1000000, msg.split("\n")[0]))
+    os.close(fd)
+    return lines
+
+
+def read_audit(path):
+    """(seq, latency_us) of every audit record that issued a firmware write."""
+    recs = []
+    with open(path, "rb") as f:
+        data = f.read()
+    for off in range(0, len(data) - AUDIT_SIZE + 1, AUDIT_SIZE):
+        _ts, lat_ns, seq, _pid, _comm, _old, _new, _src, fw, _ret = struct.unpack_from(AUDIT_FMT, data, off)
+        if fw:
+            recs.append((seq, lat_ns / 1e3))
+    return recs
+
+
+def parse_trace(lines):
+    """Returns one dict per AML method invocation."""
+    calls = []
+    cur = None
+    stack = []  # (name, start) for nested opcodes
+
+    for line in lines:
+        m = TRACE_RE.match(line)
+        if not m:
+            continue
+        ts = float(m["ts"]) * 1e6
+        edge, kind, name = m["edge"], m["kind"], m["name"]
+
+        if kind == "Method":
+            if edge == "Begin" and cur is None:
+                cur = {"start": ts, "opcodes": {}}
+            elif edge == "End" and cur is not None:
+                cur["total_us"] = ts - cur["start"]
+                calls.append(cur)
+                cur, stack = None, []
+            continue
+        if cur is None:
+            continue
+
+        if edge == "Begin":
+            stack.append((name, ts))
+        elif stack:
+            n, start = stack.pop()
+            op = cur["opcodes"].setdefault(n, [0, 0.0])
+            op[0] += 1
+            op[1] += ts - start
+
+    return calls
+
+
+def avg(xs):
+    return sum(xs) / len(xs) if xs else 0.0
+
+
+def report(calls, module_us):
+    if not calls:
+        print("no AML trace points found (CONFIG_ACPI_DEBUG? right --method?)")
+        return
+
+    total = avg([c["total_us"] for c in calls])
+    print("AML method calls: %d" % len(calls))
+    if module_us:
+        mod = avg(module_us)
+        print("module latency:   %8.1f us (avg of %d writes)" % (mod, len(module_us)))
+        print("  marshalling:    %8.1f us (module - AML method)" % max(mod - total, 0.0))
+    print("AML method:       %8.1f us" % total)
+
+    ops = {}
+    for c in calls:
+        for name, (n, us) in c["opcodes"].items():
+            o = ops.setdefault(name, [0, 0.0])
+            o[0] += n
+            o[1] += us
+    if ops:
+        print("slowest opcodes (total over all calls, includes nested time):")
+        for name, (n, us) in sorted(ops.items(), key=lambda kv: -kv[1][1])[:10]:
+            print("  %-32s %6d x %8.1f us" % (name, n, us))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0].strip())
+    ap.add_argument("--writes", type=int, default=20, help="brightness writes to profile")
+    ap.add_argument("--method", help="ACPI method path (default: found through the WMI bus)")
+    ap.add_argument("--no-opcodes", action="store_true", help="method timing only (less overhead)")
+    ap.add_argument("--log", help="parse this dmesg capture instead of running writes")
+    ap.add_argument("--audit", help="audit_bin capture to pair with --log")
+    args = ap.parse_args()
+
+    if args.log:
+        with open(args.log) as f:
+            lines = f.read().splitlines()
+        module_us = [us for _, us in read_audit(args.audit)] if args.audit else []
+        report(parse_trace(lines), module_us)
+        return
+
+    if not os.path.exists(ACPI_PARAMS + "trace_state"):
+        sys.exit("ACPI method tracing unavailable (kernel without CONFIG_ACPI_DEBUG)")
+    method = args.method or wmi_method_path()
+    if not method:
+        sys.exit("WMI method for %s not found; pass --method" % WMID_GUID4)
+
+    with open(LED_BRIGHTNESS) as f:
+        orig = f.read().strip()
+    before = {seq for seq, _ in read_audit(AUDIT_BIN)}
+    kmsg = kmsg_open()
+    try:
+        trace_enable(method, not args.no_opcodes)
+        try:
+            for i in range(args.writes):
+                with open(LED_BRIGHTNESS, "w") as f:
+                    f.write(str(40 + (i & 1)))
+                time.sleep(0.05)
+        finally:
+            trace_disable()
+
+        lines = kmsg_read(kmsg)
+        module_us = [us for seq, us in read_audit(AUDIT_BIN) if seq not in before]
+    finally:
+        # After collecting, so the restoring write is not counted
+        with open(LED_BRIGHTNESS, "w") as f:
+            f.write(orig)
+
+    print("method=%s writes=%d" % (method, args.writes))
+    report(parse_trace(lines), module_us)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,457 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * kbb_bench.c
+ *
+ * Multi-threaded contention benchmark for acer_brightness:
+ * - N writer threads write random brightness values to the LED sysfs file
+ * - M reader threads read it back
+ * - Optional synthetic typing through a uinput keyboard (drives the notifier)
+ * - Reports per-op latency distributions, and kbb_mutex contention from
+ *   /proc/lock_stat when the kernel has CONFIG_LOCK_STAT
+ * - -a N instead times N on/off writes from write() until the firmware write
+ *   lands ("lit" POLLPRI); load once with async_set=0 and once with 1 to
+ *   compare the LED core's deferred path with the module's own
+ *
+ * Meant to be run against the mock backend:
+ *   sudo insmod acer_brightness.ko mock_backend=1
+ *   sudo ./kbb_bench -w 4 -r 4 -k 20 -l 5000 -d 10
+ *   sudo ./kbb_bench -a 1000 -l 0
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#define LED_BRIGHTNESS "/sys/class/leds/acer::kbd_backlight/brightness"
+#define LED_LIT        "/sys/class/leds/acer::kbd_backlight/lit"
+#define PARAM_DIR      "/sys/module/acer_brightness/parameters/"
+#define LOCK_STAT      "/proc/lock_stat"
+
+/* log2 buckets in nanoseconds: bucket i holds [2^i, 2^(i+1)) */
+#define HIST_BUCKETS 40
+
+struct hist {
+	uint64_t bucket[HIST_BUCKETS];
+	uint64_t count;
+	uint64_t sum_ns;
+	uint64_t max_ns;
+	uint64_t errors;
+};
+
+struct worker {
+	pthread_t thread;
+	unsigned int seed;
+	struct hist hist;
+};
+
+static atomic_bool stop;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void hist_add(struct hist *h, uint64_t ns)
+{
+	int b = ns ? 63 - __builtin_clzll(ns) : 0;
+
+	if (b >= HIST_BUCKETS)
+		b = HIST_BUCKETS - 1;
+	h->bucket[b]++;
+	h->count++;
+	h->sum_ns += ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+}
+
+static void hist_merge(struct hist *dst, const struct hist *src)
+{
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+	dst->count += src->count;
+	dst->sum_ns += src->sum_ns;
+	dst->errors += src->errors;
+	if (src->max_ns > dst->max_ns)
+		dst->max_ns = src->max_ns;
+}
+
+/* Upper bound of the bucket holding the given percentile */
+static uint64_t hist_pct(const struct hist *h, double pct)
+{
+	uint64_t want = (uint64_t)(h->count * pct / 100.0);
+	uint64_t seen = 0;
+	int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++) {
+		seen += h->bucket[i];
+		if (seen > want)
+			return 2ull << i;
+	}
+	return h->max_ns;
+}
+
+static void hist_print(const char *name, const struct hist *h, double secs)
+{
+	if (!h->count) {
+		printf("%-6s no samples\n", name);
+		return;
+	}
+
+	printf("%-6s ops=%-8llu ops/s=%-9.0f err=%-5llu avg=%7.1fus p50<=%7.1fus p90<=%7.1fus p99<=%7.1fus max=%7.1fus\n",
+	       name, (unsigned long long)h->count, h->count / secs,
+	       (unsigned long long)h->errors, h->sum_ns / 1e3 / h->count,
+	       hist_pct(h, 50) / 1e3, hist_pct(h, 90) / 1e3,
+	       hist_pct(h, 99) / 1e3, h->max_ns / 1e3);
+}
+
+static int write_str(const char *path, const char *val)
+{
+	int fd = open(path, O_WRONLY);
+	ssize_t n;
+
+	if (fd < 0)
+		return -errno;
+	n = write(fd, val, strlen(val));
+	close(fd);
+
+	return n < 0 ? -errno : 0;
+}
+
+/* mock_latency_us as found, put back at exit ("" = untouched) */
+static char saved_latency[16];
+
+static void restore_latency(void)
+{
+	if (saved_latency[0] && write_str(PARAM_DIR "mock_latency_us", saved_latency))
+		fprintf(stderr, "warning: could not restore mock_latency_us=%s\n", saved_latency);
+}
+
+static int save_latency(void)
+{
+	int fd = open(PARAM_DIR "mock_latency_us", O_RDONLY);
+	ssize_t n;
+
+	if (fd < 0)
+		return -errno;
+	n = read(fd, saved_latency, sizeof(saved_latency) - 1);
+	close(fd);
+	if (n <= 0) {
+		saved_latency[0] = '\0';
+		return -EIO;
+	}
+	saved_latency[strcspn(saved_latency, "\n")] = '\0';
+	return atexit(restore_latency) ? -ENOMEM : 0;
+}
+
+/* ---- Workers ---- */
+
+static void *writer_fn(void *arg)
+{
+	struct worker *w = arg;
+	char buf[8];
+	uint64_t t0;
+	int fd, len;
+
+	fd = open(LED_BRIGHTNESS, O_WRONLY);
+	if (fd < 0) {
+		perror(LED_BRIGHTNESS);
+		return NULL;
+	}
+
+	while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+		len = snprintf(buf, sizeof(buf), "%d", rand_r(&w->seed) % 101);
+		t0 = now_ns();
+		if (pwrite(fd, buf, len, 0) != len)
+			w->hist.errors++;
+		hist_add(&w->hist, now_ns() - t0);
+	}
+
+	close(fd);
+	return NULL;
+}
+
+static void *reader_fn(void *arg)
+{
+	struct worker *w = arg;
+	char buf[8];
+	uint64_t t0;
+	int fd;
+
+	fd = open(LED_BRIGHTNESS, O_RDONLY);
+	if (fd < 0) {
+		perror(LED_BRIGHTNESS);
+		return NULL;
+	}
+
+	while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+		t0 = now_ns();
+		if (pread(fd, buf, sizeof(buf), 0) <= 0)
+			w->hist.errors++;
+		hist_add(&w->hist, now_ns() - t0);
+	}
+
+	close(fd);
+	return NULL;
+}
+
+/* ---- Write-to-apply latency ---- */
+
+static int read_lit(int fd)
+{
+	char buf[4];
+
+	return pread(fd, buf, sizeof(buf), 0) > 0 ? buf[0] == '1' : -1;
+}
+
+/*
+ * Alternates 0 and a non-zero brightness so every write flips "lit", which the
+ * module only does after the firmware write succeeded. Typing must be idle.
+ */
+static int apply_bench(int ops)
+{
+	struct pollfd pfd = { .events = POLLPRI | POLLERR };
+	struct hist h = { 0 };
+	char async[4] = "?";
+	uint64_t t0, start;
+	int fd, lit, i;
+
+	fd = open(LED_BRIGHTNESS, O_WRONLY);
+	pfd.fd = open(LED_LIT, O_RDONLY);
+	if (fd < 0 || pfd.fd < 0) {
+		perror("open LED attributes");
+		return 1;
+	}
+
+	i = open(PARAM_DIR "async_set", O_RDONLY);
+	if (i >= 0) {
+		if (read(i, async, 1) != 1)
+			async[0] = '?';
+		close(i);
+	}
+
+	start = now_ns();
+	for (i = 0; i < ops; i++) {
+		lit = read_lit(pfd.fd); /* also arms POLLPRI */
+		t0 = now_ns();
+		if (pwrite(fd, lit > 0 ? "0" : "40", lit > 0 ? 1 : 2, 0) < 0 ||
+		    poll(&pfd, 1, 1000) != 1) {
+			h.errors++;
+			continue;
+		}
+		hist_add(&h, now_ns() - t0);
+	}
+
+	printf("async_set=%c ops=%d\n", async[0], ops);
+	hist_print("apply", &h, (now_ns() - start) / 1e9);
+
+	close(pfd.fd);
+	close(fd);
+	return 0;
+}
+
+/* ---- Synthetic typing via uinput ---- */
+
+static int typing_rate;
+
+static void emit(int fd, int type, int code, int value)
+{
+	struct input_event ev = { .type = type, .code = code, .value = value };
+
+	if (write(fd, &ev, sizeof(ev)) != sizeof(ev))
+		perror("uinput write");
+}
+
+static int uinput_open(void)
+{
+	struct uinput_setup us = { 0 };
+	int fd;
+
+	fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+	if (fd < 0)
+		return -errno;
+
+	ioctl(fd, UI_SET_EVBIT, EV_KEY);
+	ioctl(fd, UI_SET_KEYBIT, KEY_A);
+
+	us.id.bustype = BUS_VIRTUAL;
+	strcpy(us.name, "kbb_bench typing");
+	if (ioctl(fd, UI_DEV_SETUP, &us) || ioctl(fd, UI_DEV_CREATE)) {
+		close(fd);
+		return -errno;
+	}
+
+	/* Give the keyboard handler time to bind to the new device */
+	usleep(200000);
+	return fd;
+}
+
+static void *typing_fn(void *arg)
+{
+	struct worker *w = arg;
+	struct timespec gap = { 0 };
+	uint64_t gap_ns;
+	int fd = uinput_open();
+
+	if (fd < 0) {
+		fprintf(stderr, "uinput: %s (typing disabled)\n", strerror(-fd));
+		return NULL;
+	}
+
+	/* tv_nsec must stay below one second, or nanosleep() fails with EINVAL */
+	gap_ns = 1000000000ull / typing_rate;
+	gap.tv_sec = gap_ns / 1000000000ull;
+	gap.tv_nsec = gap_ns % 1000000000ull;
+	while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+		emit(fd, EV_KEY, KEY_A, 1);
+		emit(fd, EV_SYN, SYN_REPORT, 0);
+		emit(fd, EV_KEY, KEY_A, 0);
+		emit(fd, EV_SYN, SYN_REPORT, 0);
+		w->hist.count++;
+		nanosleep(&gap, NULL);
+	}
+
+	ioctl(fd, UI_DEV_DESTROY);
+	close(fd);
+	return NULL;
+}
+
+/* ---- lock_stat ---- */
+
+static int lock_stat_reset(void)
+{
+	return write_str(LOCK_STAT, "0");
+}
+
+static void lock_stat_print(void)
+{
+	char line[512];
+	int in_class = 0;
+	FILE *f = fopen(LOCK_STAT, "r");
+
+	if (!f) {
+		printf("lock_stat: unavailable (kernel without CONFIG_LOCK_STAT)\n");
+		return;
+	}
+
+	/* Print the column header and the kbb_mutex block (ends at a blank line) */
+	while (fgets(line, sizeof(line), f)) {
+		if (strstr(line, "class name"))
+			fputs(line, stdout);
+		else if (strstr(line, "kbb_mutex"))
+			in_class = 1;
+		else if (line[0] == '\n')
+			in_class = 0;
+
+		if (in_class)
+			fputs(line, stdout);
+	}
+
+	fclose(f);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-w writers] [-r readers] [-k keys_per_sec] [-l mock_latency_us] [-d seconds]\n"
+		"       %s -a ops [-l mock_latency_us]\n",
+		prog, prog);
+}
+
+int main(int argc, char **argv)
+{
+	int writers = 4, readers = 4, duration = 10, latency_us = -1, apply_ops = 0;
+	struct worker *ws, typist = { 0 };
+	struct hist wr = { 0 }, rd = { 0 };
+	struct timespec run = { 0 };
+	char buf[16];
+	uint64_t t0;
+	double secs;
+	int i, opt, have_lock_stat;
+
+	while ((opt = getopt(argc, argv, "w:r:k:l:d:a:h")) != -1) {
+		switch (opt) {
+		case 'w': writers = atoi(optarg); break;
+		case 'r': readers = atoi(optarg); break;
+		case 'k': typing_rate = atoi(optarg); break;
+		case 'l': latency_us = atoi(optarg); break;
+		case 'd': duration = atoi(optarg); break;
+		case 'a': apply_ops = atoi(optarg); break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (access(LED_BRIGHTNESS, W_OK)) {
+		perror(LED_BRIGHTNESS);
+		return 1;
+	}
+
+	if (latency_us >= 0) {
+		snprintf(buf, sizeof(buf), "%d", latency_us);
+		if (save_latency() || write_str(PARAM_DIR "mock_latency_us", buf))
+			fprintf(stderr, "warning: could not set mock_latency_us\n");
+	}
+
+	if (apply_ops > 0)
+		return apply_bench(apply_ops);
+
+	have_lock_stat = !lock_stat_reset();
+
+	ws = calloc(writers + readers, sizeof(*ws));
+	if (!ws)
+		return 1;
+
+	t0 = now_ns();
+	for (i = 0; i < writers + readers; i++) {
+		ws[i].seed = i + 1;
+		pthread_create(&ws[i].thread, NULL, i < writers ? writer_fn : reader_fn, &ws[i]);
+	}
+	if (typing_rate > 0)
+		pthread_create(&typist.thread, NULL, typing_fn, &typist);
+
+	run.tv_sec = duration;
+	nanosleep(&run, NULL);
+	atomic_store(&stop, 1);
+
+	for (i = 0; i < writers + readers; i++) {
+		pthread_join(ws[i].thread, NULL);
+		hist_merge(i < writers ? &wr : &rd, &ws[i].hist);
+	}
+	if (typing_rate > 0)
+		pthread_join(typist.thread, NULL);
+	secs = (now_ns() - t0) / 1e9;
+
+	printf("writers=%d readers=%d typing=%d/s mock_latency_us=%d duration=%.1fs\n",
+	       writers, readers, typing_rate, latency_us, secs);
+	hist_print("write", &wr, secs);
+	hist_print("read", &rd, secs);
+	if (typing_rate > 0)
+		printf("keys   sent=%llu\n", (unsigned long long)typist.hist.count);
+
+	if (have_lock_stat)
+		lock_stat_print();
+	else
+		printf("lock_stat: unavailable (kernel without CONFIG_LOCK_STAT)\n");
+
+	free(ws);
+	return 0;
+}
@@ -0,0 +1,188 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+"""
+kbb_wakeups.py
+
+Idle wakeup benchmark for acer_brightness:
+- Runs typing sessions (kbb_bench typing-only) followed by idle periods
+- Traces timer expiry, workqueue execution and sched wakeups through tracefs
+- Attributes timer expiries, worker wakeups and worker runtime to the module,
+  and scales them to "per hour of use"
+
+Meant to be run against the mock backend:
+  sudo insmod acer_brightness.ko mock_backend=1
+  sudo tools/kbb_wakeups.py --sessions 3 --typing 20 --idle 60
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import time
+
+TRACEFS_CANDIDATES = ("/sys/kernel/tracing", "/sys/kernel/debug/tracing")
+
+EVENTS = (
+    "timer/timer_expire_entry",
+    "timer/timer_expire_exit",
+    "workqueue/workqueue_queue_work",
+    "workqueue/workqueue_execute_start",
+    "workqueue/workqueue_execute_end",
+    "sched/sched_wakeup",
+)
+
+# "   kworker/u16:2-123   [003] d..2.  1234.567890: event_name: payload"
+LINE_RE = re.compile(r"^\s*(?P<comm>.+?)-(?P<pid>\d+)\s+\[(?P<cpu>\d+)\].*?\s(?P<ts>\d+\.\d+):\s+(?P<event>\w+):\s(?P<rest>.*)$")
+WAKE_PID_RE = re.compile(r"\bpid=(\d+)")
+
+
+def tracefs():
+    for path in TRACEFS_CANDIDATES:
+        if os.path.exists(os.path.join(path, "trace")):
+            return path
+    sys.exit("tracefs not found (mount it or run as root)")
+
+
+def tw(root, rel, value):
+    with open(os.path.join(root, rel), "w") as f:
+        f.write(value)
+
+
+def tr(root, rel):
+    with open(os.path.join(root, rel)) as f:
+        return f.read().strip()
+
+
+def trace_setup(root, buffer_kb):
+    """Returns the previous per-CPU buffer size, for trace_stop()."""
+    # Reads "7 (expanded: 1408)" until tracing is first used; 1408 is the real size
+    m = re.search(r"expanded: (\d+)", tr(root, "buffer_size_kb"))
+    old_kb = m.group(1) if m else tr(root, "buffer_size_kb")
+    tw(root, "tracing_on", "0")
+    tw(root, "trace", "")
+    tw(root, "buffer_size_kb", str(buffer_kb))
+    for ev in EVENTS:
+        tw(root, "events/%s/enable" % ev, "1")
+    # Only worker wakeups are interesting; keeps the buffer from filling up
+    tw(root, "events/sched/sched_wakeup/filter", 'comm ~ "kworker*"')
+    tw(root, "tracing_on", "1")
+    return old_kb
+
+
+def trace_stop(root, old_kb):
+    tw(root, "tracing_on", "0")
+    for ev in EVENTS:
+        tw(root, "events/%s/enable" % ev, "0")
+    tw(root, "events/sched/sched_wakeup/filter", "0")
+    with open(os.path.join(root, "trace")) as f:
+        trace = f.read()
+    # Frees the ring buffer we grew (it is per CPU)
+    tw(root, "trace", "")
+    tw(root, "buffer_size_kb", old_kb)
+    return trace
+
+
+def analyze(trace):
+    """
+    timer expiries: a delayed_work_timer_fn expiry that queues acer work
+                    (queue_work happens inside the expiry on the same CPU)
+    worker wakeups: an acer work execution on a worker that was woken since
+                    its previous work item ended
+    runtime:        execute_start -> execute_end of acer work functions
+    """
+    in_timer = {}          # cpu -> timer expiry pending attribution
+    timer_wakeups = 0
+    woken = set()          # worker pids woken since their last work ended
+    running = {}           # pid -> (start ts, function)
+    worker_wakeups = 0
+    executions = {}
+    runtime = 0.0
+    lost = "LOST" in trace
+
+    for line in trace.splitlines():
+        m = LINE_RE.match(line)
+        if not m:
+            continue
+        cpu, pid, ts = int(m["cpu"]), int(m["pid"]), float(m["ts"])
+        ev, rest = m["event"], m["rest"]
+
+        if ev == "timer_expire_entry":
+            in_timer[cpu] = "delayed_work_timer_fn" in rest
+        elif ev == "timer_expire_exit":
+            in_timer.pop(cpu, None)
+        elif ev == "workqueue_queue_work":
+            if in_timer.get(cpu) and "workqueue=acer_brightness" in rest:
+                timer_wakeups += 1
+                in_timer[cpu] = False
+        elif ev == "sched_wakeup":
+            w = WAKE_PID_RE.search(rest)
+            if w:
+                woken.add(int(w.group(1)))
+        elif ev == "workqueue_execute_start":
+            fn = rest.split("function ")[-1].split()[0] if "function " in rest else ""
+            if fn.startswith("acer_"):
+                running[pid] = (ts, fn)
+                executions[fn] = executions.get(fn, 0) + 1
+                if pid in woken:
+                    worker_wakeups += 1
+            woken.discard(pid)
+        elif ev == "workqueue_execute_end":
+            start = running.pop(pid, None)
+            if start:
+                runtime += ts - start[0]
+            woken.discard(pid)
+
+    return {
+        "timer_wakeups": timer_wakeups,
+        "worker_wakeups": worker_wakeups,
+        "runtime_s": runtime,
+        "executions": executions,
+        "lost": lost,
+    }
+
+
+def main():
+    here = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description=__doc__.split("\n\n")[0].strip())
+    ap.add_argument("--sessions", type=int, default=3, help="typing+idle cycles")
+    ap.add_argument("--typing", type=int, default=20, help="seconds of typing per session")
+    ap.add_argument("--idle", type=int, default=60, help="seconds of idle per session")
+    ap.add_argument("--rate", type=int, default=6, help="keys per second while typing")
+    ap.add_argument("--latency-us", type=int, default=5000, help="mock_latency_us")
+    ap.add_argument("--bench", default=os.path.join(here, "kbb_bench"), help="kbb_bench binary")
+    ap.add_argument("--buffer-kb", type=int, default=4096, help="per-CPU trace buffer size (restored afterwards)")
+    args = ap.parse_args()
+
+    if not os.access(args.bench, os.X_OK):
+        sys.exit("%s not found; run 'make tools' first" % args.bench)
+
+    root = tracefs()
+    old_kb = trace_setup(root, args.buffer_kb)
+    t0 = time.monotonic()
+    try:
+        for _ in range(args.sessions):
+            subprocess.run([args.bench, "-w", "0", "-r", "0", "-k", str(args.rate),
+                            "-l", str(args.latency_us), "-d", str(args.typing)],
+                           check=True, stdout=subprocess.DEVNULL)
+            time.sleep(args.idle)
+    finally:
+        trace = trace_stop(root, old_kb)
+    elapsed = time.monotonic() - t0
+
+    r = analyze(trace)
+    per_hour = 3600.0 / elapsed
+
+    print("sessions=%d typing=%ds@%d/s idle=%ds elapsed=%.0fs"
+          % (args.sessions, args.typing, args.rate, args.idle, elapsed))
+    print("timer expiries:  %6d  (%.0f/h)" % (r["timer_wakeups"], r["timer_wakeups"] * per_hour))
+    print("worker wakeups:  %6d  (%.0f/h)" % (r["worker_wakeups"], r["worker_wakeups"] * per_hour))
+    print("worker runtime:  %6.1fms (%.1fms/h)" % (r["runtime_s"] * 1e3, r["runtime_s"] * 1e3 * per_hour))
+    for fn, n in sorted(r["executions"].items()):
+        print("  %-28s %6d  (%.0f/h)" % (fn, n, n * per_hour))
+    if r["lost"]:
+        print("warning: trace buffer overflowed, counts are low; raise --buffer-kb")
+
+
+if __name__ == "__main__":
+    main()
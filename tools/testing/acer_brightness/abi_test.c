@@ -0,0 +1,341 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * abi_test.c
+ *
+ * Checks the timing guarantees of README "Userspace ABI" against a module
+ * loaded by run.sh (mock backend, known parameters), typing through uinput:
+ * - the light goes off auto_off_ms after the last key press (within -t ms)
+ * - exactly one firmware write per off->on transition
+ * - no firmware writes while typing continuously with the light on
+ * - a runtime auto_off_ms change applies from the next key press
+ *
+ * Output is TAP; exit status 0 = pass, 1 = fail, 4 = skip (kselftest codes).
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#include "../../acerkbb.h"
+
+#define PARAM_DIR "/sys/module/acer_brightness/parameters/"
+
+#define KSFT_PASS 0
+#define KSFT_FAIL 1
+#define KSFT_SKIP 4
+
+#define CYCLES 5
+
+static struct acerkbb *h;
+static int kbd_fd = -1;
+static int auto_off_ms;
+static int tolerance_ms = 100;
+static int test_nr, failed;
+
+static int64_t now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void sleep_ms(int ms)
+{
+	struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000l };
+
+	nanosleep(&ts, NULL);
+}
+
+static void result(int ok, const char *name, const char *fmt, ...)
+	__attribute__((format(printf, 3, 4)));
+
+static void result(int ok, const char *name, const char *fmt, ...)
+{
+	va_list ap;
+
+	printf("%sok %d %s", ok ? "" : "not ", ++test_nr, name);
+	if (fmt) {
+		printf(" # ");
+		va_start(ap, fmt);
+		vprintf(fmt, ap);
+		va_end(ap);
+	}
+	printf("\n");
+	fflush(stdout);
+	if (!ok)
+		failed++;
+}
+
+/* Parameter as text ("" if unreadable); bools read as Y/N */
+static const char *read_param(const char *name)
+{
+	static char buf[16];
+	char path[128];
+	int fd;
+
+	buf[0] = '\0';
+	snprintf(path, sizeof(path), PARAM_DIR "%s", name);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return buf;
+	if (read(fd, buf, sizeof(buf) - 1) < 0)
+		buf[0] = '\0';
+	close(fd);
+	return buf;
+}
+
+static int64_t fw_writes(void)
+{
+	struct acerkbb_stats st;
+
+	return acerkbb_read_stats(h, &st) ? -1 : (int64_t)st.fw_writes;
+}
+
+/* ---- Typing through uinput (same as tools/kbb_bench) ---- */
+
+static void emit(int type, int code, int value)
+{
+	struct input_event ev = { .type = type, .code = code, .value = value };
+
+	if (write(kbd_fd, &ev, sizeof(ev)) != sizeof(ev))
+		perror("uinput write");
+}
+
+static void press_key(void)
+{
+	emit(EV_KEY, KEY_A, 1);
+	emit(EV_SYN, SYN_REPORT, 0);
+	emit(EV_KEY, KEY_A, 0);
+	emit(EV_SYN, SYN_REPORT, 0);
+}
+
+static int uinput_open(void)
+{
+	struct uinput_setup us = { 0 };
+
+	kbd_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK);
+	if (kbd_fd < 0)
+		return -errno;
+
+	ioctl(kbd_fd, UI_SET_EVBIT, EV_KEY);
+	ioctl(kbd_fd, UI_SET_KEYBIT, KEY_A);
+
+	us.id.bustype = BUS_VIRTUAL;
+	strcpy(us.name, "acer_brightness abi_test");
+	if (ioctl(kbd_fd, UI_DEV_SETUP, &us) || ioctl(kbd_fd, UI_DEV_CREATE))
+		return -errno;
+
+	/* Give the keyboard handler time to bind to the new device */
+	sleep_ms(200);
+	return 0;
+}
+
+/* Waits until lit == want; returns ms waited, or -1 on timeout */
+static int wait_lit(int want, int timeout_ms)
+{
+	int64_t t0 = now_ms(), left;
+	int lit;
+
+	for (;;) {
+		lit = acerkbb_get_lit(h);
+		if (lit == want)
+			return now_ms() - t0;
+		left = timeout_ms - (now_ms() - t0);
+		if (left <= 0)
+			return -1;
+		acerkbb_wait_event(h, left);
+	}
+}
+
+/* ---- Tests ---- */
+
+/* The light turns off at most off_ms (+ tolerance) after the last key press */
+static void check_auto_off(const char *name, int off_ms)
+{
+	int64_t t_key;
+	int waited;
+
+	/* Lit or not, this press (re)starts the countdown */
+	t_key = now_ms();
+	press_key();
+	if (wait_lit(1, 1000) < 0) {
+		result(0, name, "key press did not light the keyboard");
+		return;
+	}
+
+	if (wait_lit(0, off_ms + 10 * tolerance_ms) < 0) {
+		result(0, name, "still lit %dms after the key press", off_ms + 10 * tolerance_ms);
+		return;
+	}
+
+	waited = now_ms() - t_key;
+	/* One jiffy of rounding on the last-key timestamp can fire it slightly early */
+	result(waited >= off_ms - 20 && waited <= off_ms + tolerance_ms, name,
+	       "off after %dms (auto_off_ms=%d, tolerance=%dms)", waited, off_ms, tolerance_ms);
+}
+
+static void test_auto_off(void)
+{
+	check_auto_off("auto_off", auto_off_ms);
+}
+
+/* Each off->on costs one firmware write, however many keys arrive meanwhile */
+static void test_one_write_per_on(void)
+{
+	int64_t before, after;
+	int i, k, bad = 0;
+
+	for (i = 0; i < CYCLES; i++) {
+		if (wait_lit(0, auto_off_ms + 10 * tolerance_ms) < 0) {
+			result(0, "one_write_per_on", "cycle %d: light did not go off", i);
+			return;
+		}
+
+		before = fw_writes();
+		press_key();
+		if (wait_lit(1, 1000) < 0) {
+			result(0, "one_write_per_on", "cycle %d: key press did not light the keyboard", i);
+			return;
+		}
+		for (k = 0; k < 4; k++) {
+			sleep_ms(20);
+			press_key();
+		}
+		sleep_ms(50);
+		after = fw_writes();
+
+		if (before < 0 || after < 0) {
+			result(0, "one_write_per_on", "cannot read fw_writes (debugfs mounted?)");
+			return;
+		}
+		if (after - before != 1) {
+			printf("# cycle %d: %lld firmware writes for one off->on\n", i,
+			       (long long)(after - before));
+			bad++;
+		}
+	}
+
+	result(!bad, "one_write_per_on", "%d/%d cycles with exactly one write", CYCLES - bad, CYCLES);
+}
+
+/* Typing faster than auto_off_ms never touches the firmware while lit */
+static void test_no_writes_while_typing(void)
+{
+	int gap_ms = auto_off_ms / 10 > 0 ? auto_off_ms / 10 : 1;
+	int64_t before, after, end;
+	int went_off = 0;
+
+	press_key();
+	if (wait_lit(1, 1000) < 0) {
+		result(0, "no_writes_while_typing", "key press did not light the keyboard");
+		return;
+	}
+	sleep_ms(50);
+
+	before = fw_writes();
+	end = now_ms() + 3 * auto_off_ms;
+	while (now_ms() < end) {
+		press_key();
+		sleep_ms(gap_ms);
+		if (acerkbb_get_lit(h) != 1)
+			went_off = 1;
+	}
+	after = fw_writes();
+
+	if (before < 0 || after < 0) {
+		result(0, "no_writes_while_typing", "cannot read fw_writes (debugfs mounted?)");
+		return;
+	}
+	result(!went_off && after == before, "no_writes_while_typing",
+	       "%lld writes over %dms of typing every %dms%s", (long long)(after - before),
+	       3 * auto_off_ms, gap_ms, went_off ? ", light went off" : "");
+}
+
+/* auto_off_ms is writable at runtime; the next key press uses the new value */
+static void test_runtime_auto_off(void)
+{
+	struct acerkbb_config cfg;
+	int off_ms = auto_off_ms / 2;
+	int ret;
+
+	/* A timer armed with the old value may still be pending until then */
+	if (wait_lit(0, auto_off_ms + 10 * tolerance_ms) < 0) {
+		result(0, "runtime_auto_off", "light did not go off");
+		return;
+	}
+
+	acerkbb_config_init(&cfg);
+	cfg.auto_off_ms = off_ms;
+	ret = acerkbb_configure(h, &cfg);
+	if (ret || atoi(read_param("auto_off_ms")) != off_ms) {
+		result(0, "runtime_auto_off", "auto_off_ms=%d not taken: %s", off_ms,
+		       ret ? strerror(-ret) : read_param("auto_off_ms"));
+		return;
+	}
+
+	check_auto_off("runtime_auto_off", off_ms);
+
+	cfg.auto_off_ms = auto_off_ms;
+	acerkbb_configure(h, &cfg);
+}
+
+int main(int argc, char **argv)
+{
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "t:h")) != -1) {
+		switch (opt) {
+		case 't': tolerance_ms = atoi(optarg); break;
+		default:
+			fprintf(stderr, "Usage: %s [-t tolerance_ms]\n", argv[0]);
+			return opt == 'h' ? KSFT_PASS : KSFT_FAIL;
+		}
+	}
+
+	printf("TAP version 13\n");
+
+	h = acerkbb_open();
+	if (!h) {
+		printf("1..0 # SKIP acer_brightness not loaded\n");
+		return KSFT_SKIP;
+	}
+
+	auto_off_ms = atoi(read_param("auto_off_ms"));
+	if (auto_off_ms <= 0 || read_param("mock_backend")[0] != 'Y' || acerkbb_get_lit(h) < 0) {
+		printf("1..0 # SKIP needs mock_backend=1, auto_off_ms>0 and software auto-off (see run.sh)\n");
+		return KSFT_SKIP;
+	}
+
+	ret = uinput_open();
+	if (ret) {
+		printf("1..0 # SKIP uinput: %s\n", strerror(-ret));
+		return KSFT_SKIP;
+	}
+
+	printf("1..4\n");
+
+	/* Make sure key presses have something to turn on */
+	acerkbb_set_brightness(h, 50);
+
+	test_auto_off();
+	test_one_write_per_on();
+	test_no_writes_while_typing();
+	test_runtime_auto_off();
+
+	ioctl(kbd_fd, UI_DEV_DESTROY);
+	close(kbd_fd);
+	acerkbb_close(h);
+
+	return failed ? KSFT_FAIL : KSFT_PASS;
+}
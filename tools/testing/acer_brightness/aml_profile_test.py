@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+"""
+aml_profile_test.py
+
+Checks the kbb_aml_profile.py trace parser against lines in the format of
+the example in Documentation/firmware-guide/acpi/method-tracing.rst, as
+printed by acpi_ex_trace_point(). Needs neither root nor the module.
+"""
+
+import importlib.util
+import io
+import os
+import sys
+import unittest
+from contextlib import redirect_stdout
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+spec = importlib.util.spec_from_file_location(
+    "kbb_aml_profile", os.path.join(HERE, "..", "..", "kbb_aml_profile.py"))
+prof = importlib.util.module_from_spec(spec)
+spec.loader.exec_module(prof)
+
+SAMPLE = r"""
+[    0.186427]   exdebug-0398 ex_trace_point        : Method Begin [0xf58394d8:\_SB.PCI0.LPCB.EC0] execution.
+[    0.186630]   exdebug-0398 ex_trace_point        : Opcode Begin [0xf5905c88:If] execution.
+[    0.186820]   exdebug-0398 ex_trace_point        : Opcode Begin [0xf5905cc0:LEqual] execution.
+[    0.187010]   exdebug-0398 ex_trace_point        : Opcode Begin [0xf5905a20:-NamePath-] execution.
+[    0.187214]   exdebug-0398 ex_trace_point        : Opcode End [0xf5905a20:-NamePath-] execution.
+[    0.187410]   exdebug-0398 ex_trace_point        : Opcode End [0xf5905cc0:LEqual] execution.
+[    0.187690]   exdebug-0398 ex_trace_point        : Opcode End [0xf5905c88:If] execution.
+[    0.188146]   exdebug-0398 ex_trace_point        : Method End [0xf58394d8:\_SB.PCI0.LPCB.EC0] execution.
+[    0.190000] unrelated line
+""".strip().splitlines()
+
+
+class ParseTrace(unittest.TestCase):
+    def test_documented_line_matches(self):
+        m = prof.TRACE_RE.match(SAMPLE[0])
+        self.assertIsNotNone(m)
+        self.assertEqual((m["kind"], m["edge"], m["name"]), ("Method", "Begin", r"\_SB.PCI0.LPCB.EC0"))
+
+    def test_one_call(self):
+        calls = prof.parse_trace(SAMPLE)
+        self.assertEqual(len(calls), 1)
+        self.assertAlmostEqual(calls[0]["total_us"], 1719.0, places=3)
+
+        ops = calls[0]["opcodes"]
+        self.assertEqual(sorted(ops), ["-NamePath-", "If", "LEqual"])
+        self.assertEqual(ops["If"][0], 1)
+        self.assertAlmostEqual(ops["If"][1], 1060.0, places=3)
+        self.assertAlmostEqual(ops["-NamePath-"][1], 204.0, places=3)
+
+    def test_opcodes_outside_a_method_ignored(self):
+        self.assertEqual(prof.parse_trace(SAMPLE[1:7]), [])
+
+    def test_report(self):
+        out = io.StringIO()
+        with redirect_stdout(out):
+            prof.report(prof.parse_trace(SAMPLE * 2), [2000.0, 2100.0])
+        text = out.getvalue()
+        self.assertIn("AML method calls: 2", text)
+        self.assertIn("marshalling:", text)
+        self.assertNotIn("no AML trace points", text)
+
+
+if __name__ == "__main__":
+    sys.exit(0 if unittest.main(exit=False).result.wasSuccessful() else 1)
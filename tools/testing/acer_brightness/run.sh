@@ -0,0 +1,62 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+# Loads acer_brightness with the mock backend and runs abi_test twice: once
+# with known parameters (fixed debounce, no calibration or pre-wake), once
+# with the shipped defaults. Unloads it after each run. Needs root, uinput
+# and debugfs.
+#
+#   sudo tools/testing/acer_brightness/run.sh [path/to/acer_brightness.ko]
+
+KSFT_SKIP=4
+here=$(dirname "$(readlink -f "$0")")
+ko=${1:-$here/../../../acer_brightness.ko}
+auto_off_ms=${AUTO_OFF_MS:-500}
+
+if [ "$(id -u)" != 0 ]; then
+	echo "SKIP: needs root"
+	exit $KSFT_SKIP
+fi
+if [ ! -f "$ko" ]; then
+	echo "SKIP: $ko not built (run make)"
+	exit $KSFT_SKIP
+fi
+# Never take over the real keyboard light
+if [ -d /sys/module/acer_brightness ]; then
+	echo "SKIP: acer_brightness is already loaded"
+	exit $KSFT_SKIP
+fi
+
+modprobe uinput 2>/dev/null
+mountpoint -q /sys/kernel/debug || mount -t debugfs none /sys/kernel/debug
+
+passed=0
+failed=0
+
+# run <name> [module parameters...]
+run() {
+	name=$1
+	shift
+	echo "# $name: $*"
+
+	insmod "$ko" mock_backend=1 mock_latency_us=2000 "$@" || {
+		failed=$((failed + 1))
+		return
+	}
+	"$here/abi_test" ${TOLERANCE_MS:+-t "$TOLERANCE_MS"}
+	case $? in
+	0) passed=$((passed + 1)) ;;
+	"$KSFT_SKIP") ;;
+	*) failed=$((failed + 1)) ;;
+	esac
+	rmmod acer_brightness
+}
+
+run pinned apply_on_load=1 initial_brightness=50 auto_off_ms="$auto_off_ms" \
+	on_debounce_ms=0 prewake=0 calibrate=0
+# Adaptive debounce, calibration and pre-wake as shipped
+run defaults
+
+[ $failed -gt 0 ] && exit 1
+[ $passed -gt 0 ] && exit 0
+exit $KSFT_SKIP